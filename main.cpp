@@ -1,8 +1,23 @@
 #include "src/app.hpp"
 
-int main() {
+#include <cstring>
+#include <string>
 
-	App* vkApp = new App(1920, 1080);
+int main(int argc, char** argv) {
+
+	// --threaded-simulation steps the scene on its own thread instead of in lockstep with the frames
+	// --headless <frames> renders that many frames offscreen without a window, for machines without a display
+	bool threadedSimulation = false;
+	uint32_t headlessFrames = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--threaded-simulation") == 0) {
+			threadedSimulation = true;
+		} else if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+			headlessFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+	}
+
+	App* vkApp = new App(1920, 1080, threadedSimulation, headlessFrames);
 
 	vkApp->run();
 
@@ -2,8 +2,8 @@
 cd shaders
 # glslc shader.vert -o vert.spv
 # glslc shader.frag -o frag.spv
-# for all .vert or .frag files, compile them to "name".vert/frag.spv
-for file in *.vert *.frag
+# for all .vert, .frag or .comp files, compile them to "name".vert/frag/comp.spv
+for file in *.vert *.frag *.comp
 do
     glslc $file -o $file.spv
 done
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 450
+
+// depth pre-pass, position only and without a fragment shader
+
+layout(set = 0, binding = 0) uniform UBO {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    mat4 previousViewProjection;
+} cameraData;
+
+layout(std140, set = 0, binding = 1) readonly buffer storageBuffer {
+    mat4 model[];
+} objectData;
+
+layout(location = 0) in vec3 vertPos;
+
+// the shaded pass tests against this depth, so both have to compute it bit for bit the same
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = cameraData.viewProjection * objectData.model[gl_InstanceIndex] * vec4(vertPos, 1.0);
+}
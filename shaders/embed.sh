@@ -0,0 +1,38 @@
+#!/bin/bash
+cd shaders
+# turns every compiled shader into a constexpr array in src/embeddedshaders.hpp, run after compile.sh
+# SPIR-V is a stream of 32 bit words, od prints them in host order, which is how they are read back
+shopt -s nullglob
+out=../src/embeddedshaders.hpp
+{
+    echo "#pragma once"
+    echo ""
+    echo "// generated by shaders/embed.sh from the compiled shaders, do not edit"
+    echo ""
+    echo "#include <cstdint>"
+    echo "#include <span>"
+    echo "#include <string_view>"
+    echo ""
+    echo "namespace ASHUtil {"
+    echo "    namespace embedded {"
+    for file in *.spv
+    do
+        echo "        inline constexpr uint32_t ${file//./_}[] = {"
+        od -An -v -tx4 -w16 "$file" | sed -e 's/ \([0-9a-f]\{8\}\)/ 0x\1,/g' -e 's/^ /            /'
+        echo "        };"
+    done
+    echo "    }"
+    echo ""
+    echo "    struct EmbeddedShader {"
+    echo "        std::string_view name; // file name of the compiled shader"
+    echo "        std::span<const uint32_t> code;"
+    echo "    };"
+    echo ""
+    echo "    inline constexpr EmbeddedShader embeddedShaders[] = {"
+    for file in *.spv
+    do
+        echo "        {\"$file\", embedded::${file//./_}},"
+    done
+    echo "    };"
+    echo "}"
+} > "$out.tmp" && mv "$out.tmp" "$out"
@@ -2,11 +2,20 @@
 
 layout(location = 0) in vec3 inColor;
 layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) flat in uint inMaterial;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 1, binding = 0) uniform sampler2D material;
+// one texture per meshTypes entry, the index is constant across a draw
+layout(set = 1, binding = 0) uniform sampler2D materials[3];
+
+// set per pipeline variant, the driver drops whichever path is turned off
+layout(constant_id = 0) const bool texturing = true;
+layout(constant_id = 1) const bool vertexColor = true;
 
 void main() {
-    outColor = vec4(inColor, 1.0) * texture(material, inTexCoord);
+    outColor = vertexColor ? vec4(inColor, 1.0) : vec4(1.0);
+    if (texturing) {
+        outColor *= texture(materials[inMaterial], inTexCoord);
+    }
 }
\ No newline at end of file
@@ -4,22 +4,39 @@ layout(set = 0, binding = 0) uniform UBO {
     mat4 view;
     mat4 projection;
     mat4 viewProjection;
+    mat4 previousViewProjection;
 } cameraData;
 
 layout(std140, set = 0, binding = 1) readonly buffer storageBuffer {
     mat4 model[];
 } objectData;
 
+layout(std430, set = 0, binding = 2) readonly buffer materialBuffer {
+    uint materialIndex[];
+} materialData;
+
+// the same for every instance of a draw, pushed per draw instead of read per instance when drawParams is set
+layout(push_constant) uniform DrawParams {
+    uint material;
+} draw;
+
+layout(constant_id = 0) const bool drawParams = false;
+
 layout(location = 0) in vec3 vertPos;
 layout(location = 1) in vec3 vertColor;
 layout(location = 2) in vec2 vertexTexCoord;
 
 layout(location = 0) out vec3 outColor;
 layout(location = 1) out vec2 outTexCoord;
+layout(location = 2) flat out uint outMaterial;
+
+// matches depth.vert, whose depth the pre-pass leaves for this one to test against
+invariant gl_Position;
 
 void main()
 {
     gl_Position = cameraData.viewProjection * objectData.model[gl_InstanceIndex] * vec4(vertPos, 1.0);
     outColor = vertColor;
     outTexCoord = vertexTexCoord;
+    outMaterial = drawParams ? draw.material : materialData.materialIndex[gl_InstanceIndex];
 }
\ No newline at end of file
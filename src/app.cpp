@@ -1,16 +1,47 @@
 #include "app.hpp"
 
-App::App(int width, int height) {
-    makeGlfwWindow(width, height);
+#include <iomanip>
+#include <chrono>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double msSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // exponential moving average over roughly the last 20 samples
+    double smooth(double average, double sample) {
+        return average == 0.0 ? sample : average + (sample - average) * 0.05;
+    }
+}
+
+App::App(int width, int height, bool threadedSimulation, uint32_t headlessFrames) : m_headlessFrames(headlessFrames) {
+    if (headlessFrames == 0) {
+        makeGlfwWindow(width, height);
+    }
     m_engine = new ASH::Engine(width, height, m_window);
     m_scene = new Scene();
+
+    if (threadedSimulation) {
+        m_snapshots = new ASHUtil::TripleBuffer<Scene>(*m_scene);
+    }
 }
 
 App::~App() {
+    // run() joins it on the way out, this only catches it leaving through an exception
+    if (m_simulation.joinable()) {
+        m_stopSimulation = true;
+        m_simulation.join();
+    }
+
     delete m_engine;
+    delete m_snapshots;
     delete m_scene;
-    glfwDestroyWindow(m_window);
-    glfwTerminate();
+    if (m_window) {
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+    }
 }
 
 void App::makeGlfwWindow(int width, int height) {
@@ -29,22 +60,100 @@ void App::makeGlfwWindow(int width, int height) {
 }
 
 void App::run() {
-    while (!glfwWindowShouldClose(m_window)) {
-        glfwPollEvents();
-        m_engine->render(m_scene);
+    if (m_snapshots) {
+        m_stopSimulation = false;
+        m_simulation = std::thread(&App::simulationLoop, this);
+    }
+
+    Clock::time_point runStart = Clock::now();
+    Clock::time_point lastFrame = runStart;
+    m_lastTime = std::chrono::duration<double>(runStart.time_since_epoch()).count();
+    while (m_window ? !glfwWindowShouldClose(m_window) : m_renderedFrames < m_headlessFrames) {
+        if (m_window) {
+            glfwPollEvents();
+        }
+
+        if (m_snapshots) {
+            Clock::time_point start = Clock::now();
+            m_engine->render(&m_snapshots->acquire());
+            m_renderMs = smooth(m_renderMs, msSince(start));
+        } else {
+            // lockstep, the scene advances by however long the last frame took
+            Clock::time_point start = Clock::now();
+            m_scene->update(std::chrono::duration<double>(start - lastFrame).count());
+            lastFrame = start;
+            m_simulationMs = smooth(m_simulationMs, msSince(start));
+            ++m_simulationSteps;
+
+            start = Clock::now();
+            m_engine->render(m_scene);
+            m_renderMs = smooth(m_renderMs, msSince(start));
+        }
+        ++m_renderedFrames;
+
         calculateFrameRate();
     }
+
+    if (m_simulation.joinable()) {
+        m_stopSimulation = true;
+        m_simulation.join();
+    }
+
+    if (!m_window) {
+        double totalMs = msSince(runStart);
+        std::cout << "Rendered " << m_renderedFrames << " headless frames in " << totalMs << " ms, "
+            << totalMs / std::max<uint64_t>(m_renderedFrames, 1) << " ms per frame" << std::endl;
+    }
+}
+
+void App::simulationLoop() {
+    const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / simulationRate));
+    Clock::time_point next = Clock::now();
+
+    while (!m_stopSimulation) {
+        Clock::time_point start = Clock::now();
+        m_scene->update(1.0 / simulationRate);
+
+        // the copy reuses the storage of the snapshot the renderer let go of two publishes ago
+        m_snapshots->getWriteBuffer() = *m_scene;
+        m_snapshots->publish();
+
+        m_simulationMs = smooth(m_simulationMs, msSince(start));
+        ++m_simulationSteps;
+
+        // a step that ran late is not made up for with a burst of catch up steps
+        next = std::max(next + step, Clock::now());
+        std::this_thread::sleep_until(next);
+    }
+}
+
+ASHUtil::ThreadTimings App::getThreadTimings() const {
+    ASHUtil::ThreadTimings timings;
+    timings.simulationMs = m_simulationMs;
+    timings.simulationSteps = m_simulationSteps;
+    timings.renderMs = m_renderMs;
+    timings.renderedFrames = m_renderedFrames;
+    return timings;
 }
 
 void App::calculateFrameRate() {
-    m_currentTime = glfwGetTime();
+    // GLFW's clock needs GLFW initialized, which headless runs never do
+    m_currentTime = std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
     double delta = m_currentTime - m_lastTime;
 
     if (delta >= 1.0) {
         int framerate = std::max(1, int(m_frameCount / delta));
+        const ASHUtil::FrameStats& stats = m_engine->getStats();
         std::stringstream title;
-        title << "Vulkan (" << framerate << " fps)";
-        glfwSetWindowTitle(m_window, title.str().c_str());
+        title << "Vulkan (" << framerate << " fps, " << stats.visibleInstances << "/" << stats.totalInstances << " visible, " << stats.occludedInstances << " occluded, "
+            << stats.fragmentInvocations << " fragments shaded, "
+            << std::fixed << std::setprecision(1) << stats.presentLatencyMs << " ms to present, " << stats.gpuLatencyMs << " ms to GPU done, "
+            << std::setprecision(2) << m_simulationMs << " ms simulation, " << m_renderMs << " ms render" << (m_snapshots ? ", threaded)" : ")");
+        if (m_window) {
+            glfwSetWindowTitle(m_window, title.str().c_str());
+        } else {
+            std::cout << title.str() << std::endl;
+        }
         m_lastTime = m_currentTime;
         m_frameCount = -1;
         m_frameTime = double(1000.0 / framerate);
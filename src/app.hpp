@@ -3,24 +3,47 @@
 #include "libs.hpp"
 #include "engine.hpp"
 #include "scene.hpp"
+#include "triplebuffer.hpp"
+
+#include <thread>
+#include <atomic>
 
 class App {
     private:
         ASH::Engine* m_engine;
-        GLFWwindow *m_window;
+        GLFWwindow *m_window = nullptr;
+        uint32_t m_headlessFrames; // frames a headless run renders before run() returns
         Scene* m_scene;
 
+        // only with a separate simulation thread, which owns m_scene and publishes copies of it here
+        ASHUtil::TripleBuffer<Scene>* m_snapshots = nullptr;
+        std::thread m_simulation;
+        std::atomic<bool> m_stopSimulation{false};
+        std::atomic<double> m_simulationMs{0.0};
+        std::atomic<uint64_t> m_simulationSteps{0};
+        double m_renderMs = 0.0;
+        uint64_t m_renderedFrames = 0;
+
         double m_lastTime, m_currentTime;
         int m_frameCount = 0;
         double m_frameTime;
 
         void makeGlfwWindow(int width, int height);
 
+        void simulationLoop();
+
         void calculateFrameRate();
 
     public:
-        App(int width, int height);
+        static constexpr double simulationRate = 120.0; // steps per second of the simulation thread
+
+        // threadedSimulation steps the scene on its own thread at simulationRate while the main thread renders
+        // whichever snapshot is newest, otherwise the scene advances in lockstep with the frames
+        // headlessFrames above 0 opens no window, renders that many frames offscreen and returns from run()
+        App(int width, int height, bool threadedSimulation = false, uint32_t headlessFrames = 0);
         ~App();
 
         void run();
+
+        ASHUtil::ThreadTimings getThreadTimings() const;
 };
\ No newline at end of file
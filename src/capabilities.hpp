@@ -0,0 +1,21 @@
+#pragma once
+
+#include "libs.hpp"
+
+namespace ASHUtil {
+    // optional features the device was created with, probed and enabled once by ASHInit::createDevice so
+    // subsystems can pick their fast paths at runtime
+    struct DeviceCapabilities {
+        uint32_t apiVersion = 0;
+        bool timelineSemaphore = false; // required, frame and upload synchronization depend on it
+        bool descriptorIndexing = false; // runtime sized, partially bound and non-uniformly indexed sampled image arrays
+        bool sampledImageArrayDynamicIndexing = false;
+        bool drawIndirectCount = false; // the draw count of an indirect draw is read from a buffer
+        bool multiDrawIndirect = false;
+        bool drawIndirectFirstInstance = false;
+        bool synchronization2 = false; // VK_KHR_synchronization2
+        bool memoryBudget = false; // VK_EXT_memory_budget, per heap budget and usage
+        bool dynamicRendering = false; // VK_KHR_dynamic_rendering, no render pass or framebuffer objects
+        bool pipelineStatistics = false; // pipeline statistics queries that stay active across secondary command buffers
+    };
+}
@@ -9,7 +9,7 @@ namespace ASHInit {
     struct CommandBufferInput {
         vk::Device device;
         vk::CommandPool commandPool;
-        std::vector<ASHUtil::SwapChainFrame>& frames;
+        std::vector<ASHUtil::InFlightFrame>& frames;
     };
 
     vk::CommandPool createCommandPool(vk::Device device, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface) {
@@ -60,4 +60,55 @@ namespace ASHInit {
             }
         }
     }
-}
\ No newline at end of file
+
+    // resubmittable primary buffers, one per swapchain image for every frame
+    void createCachedCommandBuffers(CommandBufferInput input, uint32_t imageCount) {
+        vk::CommandBufferAllocateInfo allocInfo{};
+        allocInfo.commandPool = input.commandPool;
+        allocInfo.level = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = imageCount;
+
+        for (ASHUtil::InFlightFrame& frame : input.frames) {
+            try {
+                frame.cachedCommandBuffers = input.device.allocateCommandBuffers(allocInfo);
+            } catch (vk::SystemError err) {
+                throw std::runtime_error("Failed to allocate cached command buffers");
+            }
+            frame.cachedKeys.assign(imageCount, 0);
+        }
+    }
+
+    // gives every frame one transient pool per recording thread, each with a secondary command buffer per pass
+    void createRecordingBuffers(CommandBufferInput input, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, uint32_t threadCount) {
+        ASHUtil::QueueFamilyIndices queueFamilyIndices = ASHUtil::findQueueFamilies(physicalDevice, surface);
+
+        vk::CommandPoolCreateInfo poolInfo{};
+        poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        for (ASHUtil::InFlightFrame& frame : input.frames) {
+            frame.recordingPools.resize(threadCount);
+            frame.secondaryBuffers.resize(threadCount);
+
+            for (uint32_t t = 0; t < threadCount; ++t) {
+                try {
+                    frame.recordingPools[t] = input.device.createCommandPool(poolInfo);
+                } catch (vk::SystemError err) {
+                    throw std::runtime_error("Failed to create recording command pool");
+                }
+
+                vk::CommandBufferAllocateInfo allocInfo{};
+                allocInfo.commandPool = frame.recordingPools[t];
+                allocInfo.level = vk::CommandBufferLevel::eSecondary;
+                allocInfo.commandBufferCount = ASHUtil::maxRecordedPasses;
+
+                try {
+                    std::vector<vk::CommandBuffer> buffers = input.device.allocateCommandBuffers(allocInfo);
+                    std::copy(buffers.begin(), buffers.end(), frame.secondaryBuffers[t].begin());
+                } catch (vk::SystemError err) {
+                    throw std::runtime_error("Failed to allocate secondary command buffers");
+                }
+            }
+        }
+    }
+}
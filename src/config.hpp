@@ -0,0 +1,49 @@
+#pragma once
+
+#include "libs.hpp"
+
+namespace ASH {
+    enum class cullingModes {
+        CPU, // frustum test in prepFrame, visible instances are compacted before upload
+        GPU  // compute pass compacts instances and fills indirect draw commands
+    };
+
+    enum class presentModes {
+        IMMEDIATE,   // no waiting for vertical blank, lowest latency, tears
+        MAILBOX,     // newest finished frame replaces the queued one, no tearing, renders flat out
+        FIFO,        // vsync, the CPU runs ahead until the swapchain blocks it
+        FIFO_LIMITED // vsync with frames started on a fixed cadence, so few are queued and the CPU idles between them
+    };
+
+    // specialization constants of shader.frag, every combination is its own pipeline variant
+    struct ShaderFeatures {
+        bool texturing = true; // material textures, otherwise flat vertex color
+        bool vertexColor = true; // tint by vertex color, otherwise white
+
+        bool operator==(const ShaderFeatures&) const = default;
+    };
+
+    // runtime options, unsupported choices fall back to the closest supported one
+    struct EngineConfig {
+        std::string pipelineCachePath = "pipeline.cache"; // loaded at startup and written back on shutdown, empty keeps it in memory
+        std::string shaderDirectory; // compiled shaders here replace the embedded ones, for development, ASH_SHADER_DIR takes precedence
+        std::string device; // index or part of the name of the device to use, empty for the highest scoring one, ASH_DEVICE takes precedence
+        uint32_t workerThreads = 0; // job system threads besides the render thread, 0 for one per remaining core
+        bool pinWorkerThreads = false; // each worker stays on one core, Linux only
+        uint32_t framesInFlight = 2; // frames the CPU may record ahead of the GPU, 1 to 4
+        presentModes presentMode = presentModes::IMMEDIATE;
+        double targetFrameTimeMs = 1000.0 / 60.0; // FIFO_LIMITED only, ideally the display's refresh interval
+        cullingModes culling = cullingModes::GPU;
+        bool occlusionCulling = true; // two phase depth pyramid test after the frustum test, GPU culling only
+        bool softwareOcclusion = true; // occluders rasterized into a small depth buffer on the CPU, CPU culling only
+        float occluderSize = 4.0f; // mesh types with a bounds diagonal at least this long are drawn as occluders
+        uint32_t recordingThreads = 0; // threads recording a pass into secondary command buffers, 0 for every job thread, 1 records inline
+        // a pass is only split when each thread gets at least this many draws, scene passes issue one draw per mesh
+        // type (at most maxDraws), so at the default only benchmarkRecording's 4096 draw pass is ever split
+        uint32_t drawsPerRecordingThread = 32;
+        bool cacheCommandBuffers = false; // for static scenes, commands are recorded once per swapchain image and replayed until what they recorded changes
+        bool depthPrepass = false; // each pass draws its geometry depth only first, so the fragment shader runs about once per pixel
+        bool drawPushConstants = false; // per draw data such as the material is pushed before each draw instead of written per instance, rules out multi-draw
+        ShaderFeatures shaderFeatures;
+    };
+}
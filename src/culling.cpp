@@ -0,0 +1,37 @@
+#include "culling.hpp"
+
+void ASHUtil::FrustumCuller::setFrustum(const glm::mat4& viewProjection) {
+    ASHMath::extractFrustumPlanes(viewProjection, m_planes);
+}
+
+const glm::vec4* ASHUtil::FrustumCuller::getPlanes() const {
+    return m_planes;
+}
+
+uint32_t ASHUtil::FrustumCuller::cull(const glm::mat4* matrices, size_t count, const ASHMath::AABB& localBounds, glm::mat4* out, JobSystem& jobs) {
+    m_localBounds.assign(count, localBounds);
+    m_worldBounds.resize(count);
+    m_spheres.resize(count);
+    m_visible.resize(count);
+
+    jobs.parallelFor(count, 256, [&](size_t begin, size_t end) {
+        ASHMath::transformAABBs(matrices + begin, m_localBounds.data() + begin, m_worldBounds.data() + begin, end - begin);
+
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 center = (m_worldBounds[i].min + m_worldBounds[i].max) * 0.5f;
+            float radius = glm::length(m_worldBounds[i].max - m_worldBounds[i].min) * 0.5f;
+            m_spheres[i] = glm::vec4(center, radius);
+        }
+
+        ASHMath::testSpheres(m_spheres.data() + begin, end - begin, m_planes, 6, m_visible.data() + begin);
+    });
+
+    uint32_t visibleCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (m_visible[i]) {
+            out[visibleCount++] = matrices[i];
+        }
+    }
+
+    return visibleCount;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "libs.hpp"
+#include "mathkernels.hpp"
+#include "jobs.hpp"
+
+namespace ASHUtil {
+    // std430 mirrors of the structs in shaders/cull.comp
+    struct CullInstance {
+        glm::mat4 model;
+        uint32_t drawIndex;
+        uint32_t padding[3];
+    };
+
+    struct CullDraw {
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+        uint32_t material;
+        uint32_t padding[3];
+    };
+
+    enum class cullPhases : uint32_t {
+        FRUSTUM, // single pass, no occlusion test
+        EARLY,   // frustum test, then occlusion against the previous frame's depth pyramid
+        LATE     // occlusion against this frame's pyramid for what the early phase rejected
+    };
+
+    struct CullParams {
+        glm::vec4 planes[6];
+        uint32_t instanceCount;
+        uint32_t drawCount;
+        cullPhases phase;
+        uint32_t historyValid;
+    };
+
+    class FrustumCuller {
+        public:
+            void setFrustum(const glm::mat4& viewProjection);
+
+            const glm::vec4* getPlanes() const;
+
+            // tests count instances of one mesh against the frustum and writes the matrices of the visible ones to out,
+            // the tests are split over the job system and only the compaction runs on the caller
+            uint32_t cull(const glm::mat4* matrices, size_t count, const ASHMath::AABB& localBounds, glm::mat4* out, JobSystem& jobs);
+
+        private:
+            glm::vec4 m_planes[6];
+
+            std::vector<ASHMath::AABB> m_localBounds, m_worldBounds;
+            std::vector<glm::vec4> m_spheres;
+            std::vector<uint8_t> m_visible;
+    };
+}
@@ -0,0 +1,188 @@
+#include "depthpyramid.hpp"
+#include "image.hpp"
+#include "descriptors.hpp"
+#include "onetimecommands.hpp"
+
+namespace {
+    uint32_t previousPowerOfTwo(uint32_t value) {
+        uint32_t power = 1;
+        while (power * 2 <= value) {
+            power *= 2;
+        }
+        return power;
+    }
+}
+
+ASHImage::DepthPyramid::DepthPyramid(DepthPyramidInput input) {
+    m_device = input.device;
+    m_physicalDevice = input.physicalDevice;
+
+    // power of two levels, so a texel of any level covers exactly the same part of the screen as the 2x2 below it
+    // and the culling pass can map normalized coordinates onto whole texels, level 0 reduces up to 3x3 depth texels
+    vk::Extent2D extent(
+        previousPowerOfTwo(std::max(1, input.width)),
+        previousPowerOfTwo(std::max(1, input.height))
+    );
+    m_levelExtents.push_back(extent);
+    while (extent.width > 1 || extent.height > 1) {
+        extent = vk::Extent2D(std::max(1u, extent.width / 2), std::max(1u, extent.height / 2));
+        m_levelExtents.push_back(extent);
+    }
+    m_levelCount = static_cast<uint32_t>(m_levelExtents.size());
+
+    ImageInput imageInput;
+    imageInput.device = m_device;
+    imageInput.physicalDevice = m_physicalDevice;
+    imageInput.width = m_levelExtents[0].width;
+    imageInput.height = m_levelExtents[0].height;
+    imageInput.tiling = vk::ImageTiling::eOptimal;
+    imageInput.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+    imageInput.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    imageInput.format = vk::Format::eR32Sfloat;
+    imageInput.mipLevels = m_levelCount;
+
+    m_image = createImage(imageInput);
+    m_imageMemory = createImageMemory(imageInput, m_image);
+
+    m_imageView = createImageView(m_device, m_image, vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor, 0, m_levelCount);
+    for (uint32_t level = 0; level < m_levelCount; ++level) {
+        m_levelViews.push_back(createImageView(m_device, m_image, vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor, level, 1));
+    }
+
+    // the pyramid stays in the general layout, it is written as a storage image and sampled by the same stage
+    ASHUtil::startJob(input.commandBuffer, *input.timeline);
+
+    vk::ImageMemoryBarrier barrier;
+    barrier.oldLayout = vk::ImageLayout::eUndefined;
+    barrier.newLayout = vk::ImageLayout::eGeneral;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_image;
+    barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, m_levelCount, 0, 1);
+    barrier.srcAccessMask = vk::AccessFlagBits::eNoneKHR;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+    input.commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(),
+        nullptr, nullptr, barrier
+    );
+
+    ASHUtil::endJob(input.commandBuffer, input.queue, *input.timeline);
+
+    createSampler();
+
+    createDescriptorSets(input.reduceSetLayout, input.depthViews);
+}
+
+ASHImage::DepthPyramid::~DepthPyramid() {
+    m_device.destroyDescriptorPool(m_descriptorPool);
+    m_device.destroySampler(m_sampler);
+
+    for (vk::ImageView view : m_levelViews) {
+        m_device.destroyImageView(view);
+    }
+    m_device.destroyImageView(m_imageView);
+    m_device.destroyImage(m_image);
+    m_device.freeMemory(m_imageMemory);
+}
+
+void ASHImage::DepthPyramid::build(vk::CommandBuffer commandBuffer, vk::Pipeline pipeline, vk::PipelineLayout layout, uint32_t frameIndex) {
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+
+    for (uint32_t level = 0; level < m_levelCount; ++level) {
+        vk::DescriptorSet set = level == 0 ? m_depthSets[frameIndex] : m_levelSets[level - 1];
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout, 0, set, nullptr);
+
+        DepthReduceParams params{m_levelExtents[level].width, m_levelExtents[level].height};
+        commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(DepthReduceParams), &params);
+        commandBuffer.dispatch((params.width + 7) / 8, (params.height + 7) / 8, 1);
+
+        // each level reads the one before it, the last barrier also publishes the chain to the culling pass
+        vk::MemoryBarrier barrier{};
+        barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), barrier, nullptr, nullptr
+        );
+    }
+}
+
+vk::DescriptorImageInfo ASHImage::DepthPyramid::getDescriptorInfo() const {
+    vk::DescriptorImageInfo imageInfo;
+    imageInfo.imageLayout = vk::ImageLayout::eGeneral;
+    imageInfo.imageView = m_imageView;
+    imageInfo.sampler = m_sampler;
+    return imageInfo;
+}
+
+void ASHImage::DepthPyramid::createSampler() {
+    vk::SamplerCreateInfo samplerInfo;
+    samplerInfo.flags = vk::SamplerCreateFlags();
+    samplerInfo.minFilter = vk::Filter::eNearest;
+    samplerInfo.magFilter = vk::Filter::eNearest;
+    samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = vk::BorderColor::eFloatOpaqueWhite;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = vk::CompareOp::eAlways;
+    samplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+    samplerInfo.mipLodBias = 0.0f;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(m_levelCount);
+
+    try {
+        m_sampler = m_device.createSampler(samplerInfo);
+    } catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create depth pyramid sampler");
+    }
+}
+
+void ASHImage::DepthPyramid::createDescriptorSets(vk::DescriptorSetLayout layout, const std::vector<vk::ImageView>& depthViews) {
+    ASHInit::DescriptorSetLayoutData bindings;
+    bindings.count = 2;
+    bindings.types.push_back(vk::DescriptorType::eCombinedImageSampler);
+    bindings.types.push_back(vk::DescriptorType::eStorageImage);
+
+    uint32_t setCount = static_cast<uint32_t>(depthViews.size()) + m_levelCount - 1;
+    m_descriptorPool = ASHInit::createDescriptorPool(m_device, setCount, bindings);
+
+    for (vk::ImageView depthView : depthViews) {
+        vk::DescriptorSet set = ASHInit::allocateDescriptorSet(m_device, m_descriptorPool, layout);
+        writeReduceSet(set, depthView, vk::ImageLayout::eDepthStencilReadOnlyOptimal, m_levelViews[0]);
+        m_depthSets.push_back(set);
+    }
+
+    for (uint32_t level = 1; level < m_levelCount; ++level) {
+        vk::DescriptorSet set = ASHInit::allocateDescriptorSet(m_device, m_descriptorPool, layout);
+        writeReduceSet(set, m_levelViews[level - 1], vk::ImageLayout::eGeneral, m_levelViews[level]);
+        m_levelSets.push_back(set);
+    }
+}
+
+void ASHImage::DepthPyramid::writeReduceSet(vk::DescriptorSet set, vk::ImageView source, vk::ImageLayout sourceLayout, vk::ImageView destination) {
+    vk::DescriptorImageInfo sourceInfo(m_sampler, source, sourceLayout);
+    vk::DescriptorImageInfo destinationInfo(nullptr, destination, vk::ImageLayout::eGeneral);
+
+    std::array<vk::WriteDescriptorSet, 2> writeInfos;
+    writeInfos[0].dstSet = set;
+    writeInfos[0].dstBinding = 0;
+    writeInfos[0].dstArrayElement = 0;
+    writeInfos[0].descriptorCount = 1;
+    writeInfos[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    writeInfos[0].pImageInfo = &sourceInfo;
+
+    writeInfos[1].dstSet = set;
+    writeInfos[1].dstBinding = 1;
+    writeInfos[1].dstArrayElement = 0;
+    writeInfos[1].descriptorCount = 1;
+    writeInfos[1].descriptorType = vk::DescriptorType::eStorageImage;
+    writeInfos[1].pImageInfo = &destinationInfo;
+
+    m_device.updateDescriptorSets(writeInfos, nullptr);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "libs.hpp"
+#include "timeline.hpp"
+
+namespace ASHImage {
+    // matches the push constants in shaders/depthreduce.comp
+    struct DepthReduceParams {
+        uint32_t width, height;
+    };
+
+    struct DepthPyramidInput {
+        vk::Device device;
+        vk::PhysicalDevice physicalDevice;
+        vk::CommandBuffer commandBuffer;
+        vk::Queue queue;
+        ASHUtil::Timeline* timeline;
+        int width, height; // of the depth attachments
+        vk::DescriptorSetLayout reduceSetLayout;
+        std::vector<vk::ImageView> depthViews; // one per swapchain frame
+    };
+
+    // mip chain of the farthest depth in each texel, level 0 is the depth attachment's extent rounded down to
+    // powers of two
+    class DepthPyramid {
+        public:
+            DepthPyramid(DepthPyramidInput input);
+            ~DepthPyramid();
+
+            // reduces the depth attachment of the given frame into every level, the attachment must be in
+            // the depth read only layout and the levels are readable by compute shaders afterwards
+            void build(vk::CommandBuffer commandBuffer, vk::Pipeline pipeline, vk::PipelineLayout layout, uint32_t frameIndex);
+
+            // whole chain in the general layout, sampled with nearest filtering
+            vk::DescriptorImageInfo getDescriptorInfo() const;
+
+        private:
+            vk::Device m_device;
+            vk::PhysicalDevice m_physicalDevice;
+
+            uint32_t m_levelCount;
+            std::vector<vk::Extent2D> m_levelExtents;
+
+            vk::Image m_image;
+            vk::DeviceMemory m_imageMemory;
+            vk::ImageView m_imageView;
+            std::vector<vk::ImageView> m_levelViews;
+            vk::Sampler m_sampler;
+
+            vk::DescriptorPool m_descriptorPool;
+            std::vector<vk::DescriptorSet> m_depthSets; // reads a depth attachment into level 0
+            std::vector<vk::DescriptorSet> m_levelSets; // reads level i into level i + 1
+
+            void createSampler();
+
+            void createDescriptorSets(vk::DescriptorSetLayout layout, const std::vector<vk::ImageView>& depthViews);
+
+            void writeReduceSet(vk::DescriptorSet set, vk::ImageView source, vk::ImageLayout sourceLayout, vk::ImageView destination);
+    };
+}
@@ -48,6 +48,39 @@ vk::DescriptorPool ASHInit::createDescriptorPool(vk::Device device, uint32_t siz
     }
 }
 
+vk::DescriptorUpdateTemplate ASHInit::createDescriptorUpdateTemplate(
+    vk::Device device,
+    vk::DescriptorSetLayout layout,
+    const DescriptorSetLayoutData& bindings,
+    const std::vector<size_t>& offsets
+) {
+    std::vector<vk::DescriptorUpdateTemplateEntry> entries;
+    entries.reserve(bindings.count);
+
+    for (int i = 0; i < bindings.count; i++) {
+        vk::DescriptorUpdateTemplateEntry entry;
+        entry.dstBinding = bindings.indices[i];
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = bindings.counts[i];
+        entry.descriptorType = bindings.types[i];
+        entry.offset = offsets[i];
+        entry.stride = 0; // every binding here holds a single descriptor
+        entries.push_back(entry);
+    }
+
+    vk::DescriptorUpdateTemplateCreateInfo templateInfo;
+    templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+    templateInfo.pDescriptorUpdateEntries = entries.data();
+    templateInfo.templateType = vk::DescriptorUpdateTemplateType::eDescriptorSet;
+    templateInfo.descriptorSetLayout = layout;
+
+    try {
+        return device.createDescriptorUpdateTemplate(templateInfo);
+    } catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create descriptor update template");
+    }
+}
+
 vk::DescriptorSet ASHInit::allocateDescriptorSet(
     vk::Device device,
     vk::DescriptorPool pool,
@@ -15,6 +15,14 @@ namespace ASHInit {
 
     vk::DescriptorPool createDescriptorPool(vk::Device device, uint32_t size, const DescriptorSetLayoutData& bindings);
 
+    // one entry per binding, binding i is read from offsets[i] of the data passed to updateDescriptorSetWithTemplate
+    vk::DescriptorUpdateTemplate createDescriptorUpdateTemplate(
+        vk::Device device,
+        vk::DescriptorSetLayout layout,
+        const DescriptorSetLayoutData& bindings,
+        const std::vector<size_t>& offsets
+    );
+
     vk::DescriptorSet allocateDescriptorSet(
         vk::Device device,
         vk::DescriptorPool pool,
@@ -3,13 +3,38 @@
 #include "libs.hpp"
 #include "logging.hpp"
 #include "queues.hpp"
+#include "capabilities.hpp"
+
+#include <cstdlib>
+#include <cctype>
+#include <charconv>
 
 namespace ASHInit {
-    bool deviceIsSuitable(const vk::PhysicalDevice& device) {
-        const std::vector<const char*> requiredExtensions = {
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    // what pickPhysicalDevice found out about one device, printed for every device it looks at
+    struct DeviceReport {
+        uint32_t index;
+        std::string name;
+        vk::PhysicalDeviceType type;
+        bool suitable = true;
+        int64_t score = 0;
+        std::vector<std::string> reasons; // unmet requirements, or what the score is made of
+    };
+
+    // without a surface the device renders offscreen, so it doesn't need to present or have the swapchain extension
+    bool deviceIsSuitable(const vk::PhysicalDevice& device, vk::SurfaceKHR surface, std::vector<std::string>* reasons = nullptr) {
+        bool suitable = true;
+        auto reject = [&](const std::string& reason) {
+            suitable = false;
+            if (reasons) {
+                reasons->push_back(reason);
+            }
         };
 
+        std::vector<const char*> requiredExtensions;
+        if (surface) {
+            requiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+
         std::vector<vk::ExtensionProperties> availableExtensions = device.enumerateDeviceExtensionProperties();
 
         for (const char *extension : requiredExtensions) {
@@ -21,48 +46,220 @@ namespace ASHInit {
                 }
             }
             if (!found) {
-                return false;
+                reject(std::string("no ") + extension);
             }
         }
 
-        return true;
+        // frame and upload synchronization is built on a timeline semaphore
+        vk::PhysicalDeviceProperties properties = device.getProperties();
+        if (properties.apiVersion < VK_API_VERSION_1_2) {
+            reject("Vulkan " + std::to_string(VK_VERSION_MAJOR(properties.apiVersion)) + "." + std::to_string(VK_VERSION_MINOR(properties.apiVersion)) + ", needs 1.2");
+            return false;
+        }
+
+        vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures> features =
+            device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+        if (!features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore) {
+            reject("no timeline semaphores");
+        }
+
+        ASHUtil::QueueFamilyIndices indices = ASHUtil::findQueueFamilies(device, surface);
+        if (!indices.graphicsFamily.has_value()) {
+            reject("no graphics queue");
+        } else if (!indices.presentFamily.has_value()) {
+            reject("can't present to the surface");
+        }
+
+        return suitable;
     }
 
-    vk::PhysicalDevice pickPhysicalDevice(vk::Instance &instance) {
-        std::vector<vk::PhysicalDevice> devices = instance.enumeratePhysicalDevices();
+    // only called for suitable devices, the device type dominates, everything else mostly breaks ties between
+    // devices of the same type
+    int64_t scoreDevice(const vk::PhysicalDevice& device, vk::SurfaceKHR surface, std::vector<std::string>& reasons) {
+        vk::PhysicalDeviceProperties properties = device.getProperties();
+        vk::PhysicalDeviceFeatures features = device.getFeatures();
 
-        #ifdef DEBUG
-        std::cout << "Available devices:" << std::endl;
-        for (const auto &device : devices) {
-            vk::PhysicalDeviceProperties properties = device.getProperties();
-            std::cout << "\t" << properties.deviceName << std::endl;
+        int64_t score = 0;
+        auto add = [&](int64_t points, const std::string& reason) {
+            score += points;
+            reasons.push_back("+" + std::to_string(points) + " " + reason);
+        };
+
+        switch (properties.deviceType) {
+            case vk::PhysicalDeviceType::eDiscreteGpu:
+                add(10000, "discrete GPU");
+                break;
+            case vk::PhysicalDeviceType::eIntegratedGpu:
+                add(5000, "integrated GPU");
+                break;
+            case vk::PhysicalDeviceType::eVirtualGpu:
+                add(2000, "virtual GPU");
+                break;
+            case vk::PhysicalDeviceType::eCpu:
+                add(1000, "CPU implementation");
+                break;
+            default:
+                break;
         }
-        #endif
+
+        // integrated and CPU devices report system memory here, it still tells devices of one type apart
+        vk::PhysicalDeviceMemoryProperties memory = device.getMemoryProperties();
+        vk::DeviceSize localBytes = 0;
+        for (uint32_t i = 0; i < memory.memoryHeapCount; ++i) {
+            if (memory.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+                localBytes = std::max(localBytes, memory.memoryHeaps[i].size);
+            }
+        }
+        add(static_cast<int64_t>(localBytes >> 24), std::to_string(localBytes >> 20) + " MiB device local heap");
+
+        ASHUtil::QueueFamilyIndices indices = ASHUtil::findQueueFamilies(device, surface);
+        if (indices.transferFamily.has_value()) {
+            add(200, "separate transfer queue family");
+        }
+        if (surface && indices.graphicsFamily == indices.presentFamily) {
+            add(100, "presents from the graphics queue");
+        }
+
+        if (features.drawIndirectFirstInstance) {
+            add(400, "drawIndirectFirstInstance, needed for GPU culling");
+        }
+        if (features.multiDrawIndirect) {
+            add(200, "multiDrawIndirect");
+        }
+        if (features.shaderSampledImageArrayDynamicIndexing) {
+            add(50, "shaderSampledImageArrayDynamicIndexing");
+        }
+        if (properties.limits.timestampComputeAndGraphics) {
+            add(50, "timestamps on graphics and compute queues");
+        }
+        add(properties.limits.maxImageDimension2D / 1024, "maxImageDimension2D " + std::to_string(properties.limits.maxImageDimension2D));
+
+        return score;
+    }
+
+    // either an index into the enumeration order or part of the name, case insensitive
+    bool matchesDeviceOverride(const DeviceReport& report, const std::string& deviceOverride) {
+        if (std::all_of(deviceOverride.begin(), deviceOverride.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            // an index too large to parse matches no device rather than throwing
+            uint32_t index = 0;
+            std::from_chars_result parsed = std::from_chars(deviceOverride.data(), deviceOverride.data() + deviceOverride.size(), index);
+            return parsed.ec == std::errc() && index == report.index;
+        }
+
+        auto lower = [](std::string text) {
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+            return text;
+        };
+        return lower(report.name).find(lower(deviceOverride)) != std::string::npos;
+    }
+
+    void printDeviceReport(const std::vector<DeviceReport>& reports, int chosen, const std::string& deviceOverride) {
+        std::cout << yellow("Devices") << (deviceOverride.empty() ? "" : " (restricted to \"" + deviceOverride + "\")") << ":" << std::endl;
+        for (const DeviceReport& report : reports) {
+            std::string line = std::to_string(report.index) + ": " + report.name + " (" + vk::to_string(report.type) + ")";
+            if (static_cast<int>(report.index) == chosen) {
+                std::cout << "\t" << green(line + ", score " + std::to_string(report.score) + ", chosen") << std::endl;
+            } else if (report.suitable) {
+                std::cout << "\t" << line << ", score " << report.score << std::endl;
+            } else {
+                std::cout << "\t" << red(line + ", unsuitable") << std::endl;
+            }
+
+            for (const std::string& reason : report.reasons) {
+                std::cout << "\t\t" << reason << std::endl;
+            }
+        }
+    }
+
+    // the highest scoring suitable device, restricted by the ASH_DEVICE environment variable or else deviceOverride,
+    // no surface means headless
+    vk::PhysicalDevice pickPhysicalDevice(vk::Instance &instance, vk::SurfaceKHR surface, const std::string& deviceOverride = "") {
+        std::vector<vk::PhysicalDevice> devices = instance.enumeratePhysicalDevices();
 
         if (devices.empty()) {
             throw std::runtime_error("No devices found");
         }
 
-        // return the best device
-        for (const auto &device : devices) {
-            vk::PhysicalDeviceProperties properties = device.getProperties();
-            if (properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu && deviceIsSuitable(device)) {
-                return device;
+        const char* environmentOverride = std::getenv("ASH_DEVICE");
+        std::string restriction = environmentOverride && *environmentOverride ? environmentOverride : deviceOverride;
+
+        std::vector<DeviceReport> reports(devices.size());
+        int chosen = -1;
+        for (uint32_t i = 0; i < devices.size(); ++i) {
+            vk::PhysicalDeviceProperties properties = devices[i].getProperties();
+            DeviceReport& report = reports[i];
+            report.index = i;
+            report.name = properties.deviceName.data();
+            report.type = properties.deviceType;
+
+            report.suitable = deviceIsSuitable(devices[i], surface, &report.reasons);
+            if (!report.suitable) {
+                continue;
+            }
+            report.score = scoreDevice(devices[i], surface, report.reasons);
+
+            if (!restriction.empty() && !matchesDeviceOverride(report, restriction)) {
+                report.reasons.push_back("skipped, doesn't match \"" + restriction + "\"");
+                continue;
+            }
+            if (chosen < 0 || report.score > reports[chosen].score) {
+                chosen = static_cast<int>(i);
             }
         }
 
-        throw std::runtime_error("No suitable devices found");
-        return nullptr;
+        printDeviceReport(reports, chosen, restriction);
+
+        if (chosen < 0) {
+            throw std::runtime_error(restriction.empty() ? "No suitable devices found" : "No suitable device matches \"" + restriction + "\"");
+        }
+        return devices[chosen];
     }
 
    
-    vk::Device createDevice(const vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface) {
+    // one row per optional feature, and the heap budgets when the device can report them
+    void printCapabilities(const vk::PhysicalDevice physicalDevice, const ASHUtil::DeviceCapabilities& capabilities) {
+        std::vector<std::pair<const char*, bool>> rows = {
+            {"timeline semaphores", capabilities.timelineSemaphore},
+            {"descriptor indexing", capabilities.descriptorIndexing},
+            {"dynamic sampled image indexing", capabilities.sampledImageArrayDynamicIndexing},
+            {"draw indirect count", capabilities.drawIndirectCount},
+            {"multi draw indirect", capabilities.multiDrawIndirect},
+            {"draw indirect first instance", capabilities.drawIndirectFirstInstance},
+            {"synchronization2", capabilities.synchronization2},
+            {"memory budget", capabilities.memoryBudget},
+            {"dynamic rendering", capabilities.dynamicRendering},
+            {"pipeline statistics", capabilities.pipelineStatistics}
+        };
+
+        std::cout << yellow("Device capabilities") << " (Vulkan " << VK_VERSION_MAJOR(capabilities.apiVersion) << "." << VK_VERSION_MINOR(capabilities.apiVersion) << "):" << std::endl;
+        for (const auto& [name, enabled] : rows) {
+            std::string padded = name;
+            padded.resize(32, ' ');
+            std::cout << "\t" << padded << (enabled ? green("enabled") : red("unsupported")) << std::endl;
+        }
+
+        if (capabilities.memoryBudget) {
+            vk::StructureChain<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT> memory =
+                physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            const vk::PhysicalDeviceMemoryProperties& properties = memory.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+            const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& budget = memory.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            for (uint32_t i = 0; i < properties.memoryHeapCount; ++i) {
+                std::cout << "\theap " << i << ": " << (budget.heapUsage[i] >> 20) << " of " << (budget.heapBudget[i] >> 20) << " MiB budget used" << std::endl;
+            }
+        }
+    }
+
+    // enables every optional feature in ASHUtil::DeviceCapabilities the device supports and records which ones it did
+    vk::Device createDevice(const vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, ASHUtil::DeviceCapabilities& capabilities) {
         ASHUtil::QueueFamilyIndices indices = ASHUtil::findQueueFamilies(physicalDevice, surface, true);
         std::vector<uint32_t> uniqueIndices;
         uniqueIndices.push_back(indices.graphicsFamily.value());
         if (indices.graphicsFamily.value() != indices.presentFamily.value()) {
             uniqueIndices.push_back(indices.presentFamily.value());
         }
+        if (indices.transferFamily.has_value() && indices.transferFamily.value() != indices.presentFamily.value()) {
+            uniqueIndices.push_back(indices.transferFamily.value());
+        }
         float queuePriority = 1.0f;
 
         std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
@@ -77,18 +274,105 @@ namespace ASHInit {
             );
         }
 
-        std::vector<const char*> deviceExtensions = {
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME
+        std::vector<const char*> deviceExtensions;
+        if (surface) {
+            deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+
+        std::vector<vk::ExtensionProperties> availableExtensions = physicalDevice.enumerateDeviceExtensionProperties();
+        auto hasExtension = [&](const char* name) {
+            for (const vk::ExtensionProperties& extension : availableExtensions) {
+                if (strcmp(name, extension.extensionName) == 0) {
+                    return true;
+                }
+            }
+            return false;
         };
+        bool hasSynchronization2 = hasExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        bool hasDynamicRendering = hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+        // extension feature structs are only chained when the extension is there
+        vk::PhysicalDeviceFeatures2 supported{};
+        vk::PhysicalDeviceVulkan12Features supported12{};
+        vk::PhysicalDeviceSynchronization2FeaturesKHR supportedSynchronization2{};
+        vk::PhysicalDeviceDynamicRenderingFeaturesKHR supportedDynamicRendering{};
+        supported.pNext = &supported12;
+        if (hasSynchronization2) {
+            supportedSynchronization2.pNext = supported.pNext;
+            supported.pNext = &supportedSynchronization2;
+        }
+        if (hasDynamicRendering) {
+            supportedDynamicRendering.pNext = supported.pNext;
+            supported.pNext = &supportedDynamicRendering;
+        }
+        vkGetPhysicalDeviceFeatures2(physicalDevice, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&supported));
+
+        capabilities = ASHUtil::DeviceCapabilities{};
+        capabilities.apiVersion = physicalDevice.getProperties().apiVersion;
+
+        vk::PhysicalDeviceFeatures2 enabled{};
+        // GPU culling writes indirect draws that start past instance 0
+        enabled.features.drawIndirectFirstInstance = supported.features.drawIndirectFirstInstance;
+        // all mesh types are drawn with one indirect call, materials are picked in the fragment shader
+        enabled.features.multiDrawIndirect = supported.features.multiDrawIndirect;
+        enabled.features.shaderSampledImageArrayDynamicIndexing = supported.features.shaderSampledImageArrayDynamicIndexing;
+        capabilities.drawIndirectFirstInstance = enabled.features.drawIndirectFirstInstance;
+        capabilities.multiDrawIndirect = enabled.features.multiDrawIndirect;
+        capabilities.sampledImageArrayDynamicIndexing = enabled.features.shaderSampledImageArrayDynamicIndexing;
+        // counting shaded fragments, the query spans passes recorded into secondary command buffers
+        if (supported.features.pipelineStatisticsQuery && supported.features.inheritedQueries) {
+            enabled.features.pipelineStatisticsQuery = VK_TRUE;
+            enabled.features.inheritedQueries = VK_TRUE;
+            capabilities.pipelineStatistics = true;
+        }
+
+        // deviceIsSuitable already checked for it
+        vk::PhysicalDeviceVulkan12Features enabled12{};
+        enabled12.timelineSemaphore = VK_TRUE;
+        capabilities.timelineSemaphore = true;
 
-        // vk::PhysicalDeviceFeatures deviceFeatures = physicalDevice.getFeatures();
-        vk::PhysicalDeviceFeatures deviceFeatures = vk::PhysicalDeviceFeatures();
+        enabled12.drawIndirectCount = supported12.drawIndirectCount;
+        capabilities.drawIndirectCount = enabled12.drawIndirectCount;
+
+        // only worth having as a whole, a bindless material array needs all three
+        if (supported12.runtimeDescriptorArray && supported12.shaderSampledImageArrayNonUniformIndexing && supported12.descriptorBindingPartiallyBound) {
+            enabled12.descriptorIndexing = supported12.descriptorIndexing;
+            enabled12.runtimeDescriptorArray = VK_TRUE;
+            enabled12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            enabled12.descriptorBindingPartiallyBound = VK_TRUE;
+            capabilities.descriptorIndexing = true;
+        }
+        enabled.pNext = &enabled12;
+
+        vk::PhysicalDeviceSynchronization2FeaturesKHR enabledSynchronization2{};
+        if (hasSynchronization2 && supportedSynchronization2.synchronization2) {
+            deviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+            enabledSynchronization2.synchronization2 = VK_TRUE;
+            enabledSynchronization2.pNext = enabled.pNext;
+            enabled.pNext = &enabledSynchronization2;
+            capabilities.synchronization2 = true;
+        }
+
+        vk::PhysicalDeviceDynamicRenderingFeaturesKHR enabledDynamicRendering{};
+        if (hasDynamicRendering && supportedDynamicRendering.dynamicRendering) {
+            deviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+            enabledDynamicRendering.dynamicRendering = VK_TRUE;
+            enabledDynamicRendering.pNext = enabled.pNext;
+            enabled.pNext = &enabledDynamicRendering;
+            capabilities.dynamicRendering = true;
+        }
+
+        if (hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+            deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            capabilities.memoryBudget = true;
+        }
 
         std::vector<const char*> enabledLayers;
         #ifdef DEBUG
         enabledLayers.push_back("VK_LAYER_KHRONOS_validation");
         #endif
 
+        // the features come through pNext, so pEnabledFeatures stays null
         vk::DeviceCreateInfo deviceInfo = vk::DeviceCreateInfo(
             vk::DeviceCreateFlags(),
             queueCreateInfos.size(),
@@ -97,8 +381,11 @@ namespace ASHInit {
             enabledLayers.data(),
             deviceExtensions.size(),
             deviceExtensions.data(),
-            &deviceFeatures
+            nullptr
         );
+        deviceInfo.pNext = &enabled;
+
+        printCapabilities(physicalDevice, capabilities);
 
         try {
             vk::Device device = physicalDevice.createDevice(deviceInfo);
@@ -112,12 +399,14 @@ namespace ASHInit {
 
     }
 
-    std::array<vk::Queue, 2> createQueues(vk::PhysicalDevice physicalDevice, vk::Device device, vk::SurfaceKHR surface) {
+    // graphics, present and transfer, the transfer queue is the graphics queue when there is no separate family
+    std::array<vk::Queue, 3> createQueues(vk::PhysicalDevice physicalDevice, vk::Device device, vk::SurfaceKHR surface) {
         ASHUtil::QueueFamilyIndices indices = ASHUtil::findQueueFamilies(physicalDevice, surface);
 
         return {
             device.getQueue(indices.graphicsFamily.value(), 0),
-            device.getQueue(indices.presentFamily.value(), 0)
+            device.getQueue(indices.presentFamily.value(), 0),
+            device.getQueue(indices.transferFamily.value_or(indices.graphicsFamily.value()), 0)
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "drawbatch.hpp"
+#include "pipelineregistry.hpp"
+
+void ASHUtil::DrawBatch::clear() {
+    m_commands.clear();
+    m_params.clear();
+}
+
+uint32_t ASHUtil::DrawBatch::add(uint32_t indexCount, uint32_t firstIndex, uint32_t firstInstance, uint32_t instanceCount, uint32_t material) {
+    vk::DrawIndexedIndirectCommand command{};
+    command.indexCount = indexCount;
+    command.instanceCount = instanceCount;
+    command.firstIndex = firstIndex;
+    command.vertexOffset = 0;
+    command.firstInstance = firstInstance;
+    m_commands.push_back(command);
+    m_params.push_back(DrawParams{material});
+
+    return static_cast<uint32_t>(m_commands.size() - 1);
+}
+
+uint32_t ASHUtil::DrawBatch::size() const {
+    return static_cast<uint32_t>(m_commands.size());
+}
+
+uint64_t ASHUtil::DrawBatch::hash(uint64_t seed) const {
+    for (size_t i = 0; i < m_commands.size(); ++i) {
+        uint32_t mesh[] = {m_commands[i].indexCount, m_commands[i].firstIndex};
+        seed = hashState(seed, mesh, sizeof(mesh));
+        seed = hashState(seed, &m_params[i], sizeof(DrawParams));
+    }
+    return seed;
+}
+
+void ASHUtil::DrawBatch::upload(void* writePtr) const {
+    memcpy(writePtr, m_commands.data(), m_commands.size() * sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+void ASHUtil::DrawBatch::record(vk::CommandBuffer commandBuffer, vk::Buffer indirectBuffer, vk::DeviceSize offset, bool multiDrawIndirect) const {
+    recordRange(commandBuffer, indirectBuffer, offset, multiDrawIndirect, 0, size());
+}
+
+void ASHUtil::DrawBatch::recordRange(vk::CommandBuffer commandBuffer, vk::Buffer indirectBuffer, vk::DeviceSize offset, bool multiDrawIndirect, uint32_t first, uint32_t count) const {
+    uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    offset += vk::DeviceSize(first) * stride;
+
+    if (count == 0) {
+        return;
+    }
+
+    if (multiDrawIndirect) {
+        commandBuffer.drawIndexedIndirect(indirectBuffer, offset, count, stride);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        commandBuffer.drawIndexedIndirect(indirectBuffer, offset + i * stride, 1, stride);
+    }
+}
+
+void ASHUtil::DrawBatch::recordRangeWithParams(vk::CommandBuffer commandBuffer, vk::Buffer indirectBuffer, vk::DeviceSize offset, vk::PipelineLayout layout, uint32_t first, uint32_t count) const {
+    uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+    for (uint32_t i = first; i < first + count; ++i) {
+        commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(DrawParams), &m_params[i]);
+        commandBuffer.drawIndexedIndirect(indirectBuffer, offset + vk::DeviceSize(i) * stride, 1, stride);
+    }
+}
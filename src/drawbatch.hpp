@@ -0,0 +1,38 @@
+#pragma once
+
+#include "libs.hpp"
+#include "renderstructs.hpp"
+
+namespace ASHUtil {
+    // collects one indirect command per mesh type and submits them together
+    class DrawBatch {
+        public:
+            void clear();
+
+            // returns the draw index of the new command, material is only read by recordRangeWithParams
+            uint32_t add(uint32_t indexCount, uint32_t firstIndex, uint32_t firstInstance, uint32_t instanceCount, uint32_t material = 0);
+
+            uint32_t size() const;
+
+            // of what recording bakes in, the mesh each command draws and its DrawParams, instance ranges are
+            // read from the indirect buffer and left out
+            uint64_t hash(uint64_t seed) const;
+
+            // copies the commands into a mapped indirect buffer
+            void upload(void* writePtr) const;
+
+            // one multi-draw call when supported, otherwise one indirect draw per command
+            void record(vk::CommandBuffer commandBuffer, vk::Buffer indirectBuffer, vk::DeviceSize offset, bool multiDrawIndirect) const;
+
+            // the same for count commands starting at first, so a batch can be split over several command buffers
+            void recordRange(vk::CommandBuffer commandBuffer, vk::Buffer indirectBuffer, vk::DeviceSize offset, bool multiDrawIndirect, uint32_t first, uint32_t count) const;
+
+            // one indirect draw per command with its DrawParams pushed to the vertex stage before it, never a
+            // multi-draw since the push constants change between draws
+            void recordRangeWithParams(vk::CommandBuffer commandBuffer, vk::Buffer indirectBuffer, vk::DeviceSize offset, vk::PipelineLayout layout, uint32_t first, uint32_t count) const;
+
+        private:
+            std::vector<vk::DrawIndexedIndirectCommand> m_commands;
+            std::vector<DrawParams> m_params;
+    };
+}
@@ -11,29 +11,72 @@
 #include "descriptors.hpp"
 #include "obj.hpp"
 
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double msBetween(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // exponential moving average over roughly the last 20 samples
+    double smooth(double average, double sample) {
+        return average == 0.0 ? sample : average + (sample - average) * 0.05;
+    }
+}
+
 namespace ASH {
-    Engine::Engine(int width, int height, GLFWwindow *window) : m_width(width), m_height(height), m_window(window) {
+    Engine::Engine(int width, int height, GLFWwindow *window, EngineConfig config) : m_width(width), m_height(height), m_config(config), m_window(window), m_headless(window == nullptr),
+        m_jobs(config.workerThreads == 0 ? ASHUtil::JobSystem::defaultWorkerCount() : config.workerThreads, config.pinWorkerThreads) {
+        #ifdef DEBUG
+        std::cout << "Math kernels: " << ASHMath::simdLevelName(ASHMath::getSimdLevel()) << std::endl;
+        std::cout << "Worker threads: " << m_jobs.size() << std::endl;
+        #endif
+        #ifdef BENCHMARK
+        ASHMath::benchmarkKernels();
+        ASHUtil::JobSystem::benchmark();
+        #endif
+
         createInstance();
         createDevice();
         createDescriptorSetLayouts();
         createPipeline();
         finishSetup();
         createAssets();
+
+        #ifdef BENCHMARK
+        benchmarkRecording();
+        #endif
     }
 
     Engine::~Engine() {
+        // the present queue too, not just what the timeline tracks
         m_device.waitIdle();
+        // retired swapchains free their cached command buffers from m_commandPool
+        m_timeline->collect();
 
         m_device.destroyCommandPool(m_commandPool);
 
-        m_device.destroyPipeline(m_pipeline);
+        // waits for compiles still running
+        delete m_pipelines;
         m_device.destroyPipelineLayout(m_pipelineLayout);
         m_device.destroyRenderPass(m_renderPass);
+        if (m_config.occlusionCulling) {
+            m_device.destroyRenderPass(m_earlyRenderPass);
+            m_device.destroyRenderPass(m_lateRenderPass);
+        }
+
+        m_device.destroyPipelineLayout(m_cullPipelineLayout);
+        m_device.destroyPipelineLayout(m_depthReducePipelineLayout);
 
         destroySwapchain();
+        destroyFramesInFlight();
 
+        m_device.destroyDescriptorUpdateTemplate(m_frameUpdateTemplate);
+        m_device.destroyDescriptorUpdateTemplate(m_cullUpdateTemplate);
         m_device.destroyDescriptorSetLayout(m_frameSetLayout);
-        // frame descriptor pool is destroyed in destroySwapchain
+        m_device.destroyDescriptorSetLayout(m_cullSetLayout);
+        m_device.destroyDescriptorSetLayout(m_depthReduceSetLayout);
+        // the depth pyramid is destroyed in destroySwapchain, the frame and cull descriptor pools in destroyFramesInFlight
 
         delete m_meshes;
 
@@ -44,23 +87,38 @@ namespace ASH {
         m_device.destroyDescriptorSetLayout(m_meshSetLayout);
         m_device.destroyDescriptorPool(m_meshPool);
 
+        delete m_latency;
+
+        // writes the cache file
+        delete m_pipelineCache;
+
+        // both run their remaining deferred deletions
+        delete m_transfer;
+        delete m_timeline;
+
         m_device.destroy();
         #ifdef DEBUG
         m_instance.destroyDebugUtilsMessengerEXT(m_debugMessenger, nullptr, m_dispatchLoader);
         #endif
-        m_instance.destroySurfaceKHR(m_surface);
+        if (m_surface) {
+            m_instance.destroySurfaceKHR(m_surface);
+        }
 
         m_instance.destroy();
     }
 
     void Engine::createInstance() {
-        m_instance = ASHInit::createInstance("Vulkan");
+        m_instance = ASHInit::createInstance("Vulkan", m_headless);
         m_dispatchLoader = vk::DispatchLoaderDynamic(m_instance, vkGetInstanceProcAddr);
 
         #ifdef DEBUG
         m_debugMessenger = ASHInit::setupDebugMessenger(m_instance, m_dispatchLoader);
         #endif
 
+        if (m_headless) {
+            return;
+        }
+
         if (glfwCreateWindowSurface(m_instance, m_window, nullptr, reinterpret_cast<VkSurfaceKHR *>(&m_surface)) != VK_SUCCESS) {
             std::cerr << "Failed to create window surface" << std::endl;
             exit(1);
@@ -68,23 +126,102 @@ namespace ASH {
     }
 
     void Engine::createDevice() {
-        m_physicalDevice = ASHInit::pickPhysicalDevice(m_instance);
-        m_device = ASHInit::createDevice(m_physicalDevice, m_surface);
-        std::array<vk::Queue, 2> queues = ASHInit::createQueues(m_physicalDevice, m_device, m_surface);
+        m_physicalDevice = ASHInit::pickPhysicalDevice(m_instance, m_surface, m_config.device);
+        m_device = ASHInit::createDevice(m_physicalDevice, m_surface, m_capabilities);
+        std::array<vk::Queue, 3> queues = ASHInit::createQueues(m_physicalDevice, m_device, m_surface);
         m_graphicsQueue = queues[0];
         m_presentQueue = queues[1];
-        createSwapchain();
+        m_transferQueue = queues[2];
+
+        m_pipelineCache = new ASHUtil::PipelineCache(m_device, m_physicalDevice, m_config.pipelineCachePath);
+        m_timeline = new ASHUtil::Timeline(m_device);
+        m_latency = new ASHUtil::FrameLatencyTracker(m_device, m_timeline->getSemaphore());
+
+        ASHUtil::QueueFamilyIndices indices = ASHUtil::findQueueFamilies(m_physicalDevice, m_surface);
+        ASHUtil::TransferQueueInput transferInput{};
+        transferInput.device = m_device;
+        transferInput.queue = m_transferQueue;
+        transferInput.graphicsFamily = indices.graphicsFamily.value();
+        transferInput.transferFamily = indices.transferFamily.value_or(indices.graphicsFamily.value());
+        m_transfer = new ASHUtil::TransferQueue(transferInput);
+        #ifdef DEBUG
+        if (!m_transfer->isDedicated()) {
+            std::cout << yellow("No separate transfer queue family, uploads share the graphics queue") << std::endl;
+        }
+        #endif
+
+        if (m_config.culling == cullingModes::GPU && !m_capabilities.drawIndirectFirstInstance) {
+            #ifdef DEBUG
+            std::cout << yellow("drawIndirectFirstInstance unsupported, culling on the CPU") << std::endl;
+            #endif
+            m_config.culling = cullingModes::CPU;
+        }
+
+        if (m_config.culling == cullingModes::CPU) {
+            m_config.occlusionCulling = false;
+        } else {
+            m_config.softwareOcclusion = false;
+        }
+
+        m_config.framesInFlight = std::clamp(m_config.framesInFlight, 1u, 4u);
+
+        uint32_t poolThreads = static_cast<uint32_t>(m_jobs.size());
+        m_config.recordingThreads = m_config.recordingThreads == 0 ? poolThreads : std::min(m_config.recordingThreads, poolThreads);
+        m_config.drawsPerRecordingThread = std::max(m_config.drawsPerRecordingThread, 1u);
+        if (m_config.cacheCommandBuffers) {
+            // the recording pools are reset every frame, which would invalidate any cached buffer executing their secondaries
+            m_config.recordingThreads = 1;
+        }
+
+        // push constants can't change within a multi-draw
+        m_multiDrawIndirect = m_capabilities.multiDrawIndirect && !m_config.drawPushConstants;
+        #ifdef DEBUG
+        if (!m_multiDrawIndirect) {
+            std::cout << yellow("multiDrawIndirect unsupported, issuing one indirect draw per mesh type") << std::endl;
+        }
+        #endif
+
+        #ifdef BENCHMARK
+        vk::PhysicalDeviceProperties properties = m_physicalDevice.getProperties();
+        m_timestampPeriod = properties.limits.timestampComputeAndGraphics ? properties.limits.timestampPeriod : 0.0f;
+        #endif
+
+        if (m_headless) {
+            createOffscreenTargets();
+        } else {
+            createSwapchain();
+        }
         m_currentFrame = 0;
     }
 
-    void Engine::createSwapchain() {
-        ASHInit::SwapChainBundle bundle = ASHInit::createSwapchain(m_device, m_physicalDevice, m_surface, m_width, m_height);
+    void Engine::createSwapchain(vk::SwapchainKHR oldSwapchain) {
+        ASHInit::SwapChainBundle bundle = ASHInit::createSwapchain(m_device, m_physicalDevice, m_surface, m_width, m_height, getPresentMode(), oldSwapchain);
         m_swapchain = bundle.swapChain;
         m_swapchainFrames = bundle.frames;
         m_swapchainFormat = bundle.imageFormat;
         m_swapchainExtent = bundle.extent;
 
-        m_maxFramesInFlight = static_cast<int>(m_swapchainFrames.size());
+        // the ring is independent of the image count, images are only matched to the slot that last used them
+        m_imagesInFlight.assign(m_swapchainFrames.size(), 0);
+
+        for (ASHUtil::SwapChainFrame& frame : m_swapchainFrames) {
+            frame.device = m_device;
+            frame.physicalDevice = m_physicalDevice;
+            frame.width = m_swapchainExtent.width;
+            frame.height = m_swapchainExtent.height;
+
+            frame.createDepthResources();
+            frame.renderFinishedSemaphore = ASHInit::createSemaphore(m_device);
+        }
+    }
+
+    void Engine::createOffscreenTargets() {
+        // one per ring slot, so no frame waits on the one before it for its target
+        m_swapchainFormat = vk::Format::eB8G8R8A8Unorm;
+        m_swapchainExtent = vk::Extent2D{static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height)};
+        m_swapchainFrames.resize(m_config.framesInFlight);
+        m_imagesInFlight.assign(m_swapchainFrames.size(), 0);
+        m_nextOffscreenImage = 0;
 
         for (ASHUtil::SwapChainFrame& frame : m_swapchainFrames) {
             frame.device = m_device;
@@ -92,10 +229,31 @@ namespace ASH {
             frame.width = m_swapchainExtent.width;
             frame.height = m_swapchainExtent.height;
 
+            frame.createOffscreenImage(m_swapchainFormat);
             frame.createDepthResources();
         }
     }
 
+    vk::PresentModeKHR Engine::getPresentMode() const {
+        switch (m_config.presentMode) {
+            case presentModes::IMMEDIATE:
+                return vk::PresentModeKHR::eImmediate;
+            case presentModes::MAILBOX:
+                return vk::PresentModeKHR::eMailbox;
+            default:
+                return vk::PresentModeKHR::eFifo;
+        }
+    }
+
+    void Engine::setPresentMode(presentModes mode) {
+        m_config.presentMode = mode;
+        // offscreen targets aren't presented, pacing is all the mode changes there
+        if (!m_headless) {
+            recreateSwapchain();
+        }
+        m_nextFrameStart = Clock::now();
+    }
+
     void Engine::recreateSwapchain() {
         m_width = 0;
         m_height = 0;
@@ -104,22 +262,53 @@ namespace ASH {
             glfwWaitEvents();
         }
 
-        m_device.waitIdle();
-        #ifdef DEBUG
-        std::cout << "Recreating swapchain" << std::endl;
-        #endif
-        destroySwapchain();
-        createSwapchain();
+        Clock::time_point start = Clock::now();
+
+        // the frames still in flight keep their images, framebuffers and depth pyramid until they are done with them
+        vk::SwapchainKHR oldSwapchain = m_swapchain;
+        std::vector<ASHUtil::SwapChainFrame> oldFrames = std::move(m_swapchainFrames);
+        ASHImage::DepthPyramid* oldPyramid = m_depthPyramid;
+
+        // the cached buffers point at the old framebuffers, and the image count may change
+        std::vector<vk::CommandBuffer> oldCache;
+        for (ASHUtil::InFlightFrame& frame : m_frames) {
+            oldCache.insert(oldCache.end(), frame.cachedCommandBuffers.begin(), frame.cachedCommandBuffers.end());
+            frame.cachedCommandBuffers.clear();
+            frame.cachedKeys.clear();
+        }
+
+        createSwapchain(oldSwapchain);
         createFramebuffers();
         createFrameResources();
-        ASHInit::CommandBufferInput cbInput = {m_device, m_commandPool, m_swapchainFrames};
-        ASHInit::createFrameCommandBuffers(cbInput);
+        createCommandCache();
 
+        // the timeline doesn't cover the presentation engine, but an image is only presented after the submission
+        // that renders it, and nothing is acquired from the old swapchain anymore
+        m_timeline->destroyAfter(m_timeline->getLastSubmitted(), [device = m_device, pool = m_commandPool, oldSwapchain, oldFrames, oldPyramid, oldCache]() mutable {
+            if (!oldCache.empty()) {
+                device.freeCommandBuffers(pool, oldCache);
+            }
+            for (ASHUtil::SwapChainFrame& frame : oldFrames) {
+                frame.destroy();
+            }
+            device.destroySwapchainKHR(oldSwapchain);
+            delete oldPyramid;
+        });
+
+        m_stats.swapchainRecreateMs = msBetween(start, Clock::now());
+        ++m_stats.swapchainRecreations;
+        #ifdef BENCHMARK
+        m_resizePending = true;
+        #endif
+        #ifdef DEBUG
+        std::cout << "Recreated swapchain at " << m_swapchainExtent.width << "x" << m_swapchainExtent.height << " in "
+            << m_stats.swapchainRecreateMs << " ms" << std::endl;
+        #endif
     }
 
     void Engine::createDescriptorSetLayouts() {
         ASHInit::DescriptorSetLayoutData bindings;
-        bindings.count = 2;
+        bindings.count = 3;
         bindings.indices.push_back(0);
         bindings.types.push_back(vk::DescriptorType::eUniformBuffer);
         bindings.counts.push_back(1);
@@ -130,50 +319,356 @@ namespace ASH {
         bindings.counts.push_back(1);
         bindings.stages.push_back(vk::ShaderStageFlagBits::eVertex);
 
+        bindings.indices.push_back(2);
+        bindings.types.push_back(vk::DescriptorType::eStorageBuffer);
+        bindings.counts.push_back(1);
+        bindings.stages.push_back(vk::ShaderStageFlagBits::eVertex);
+
         m_frameSetLayout = ASHInit::createDescriptorSetLayout(m_device, bindings);
+        m_frameUpdateTemplate = ASHInit::createDescriptorUpdateTemplate(m_device, m_frameSetLayout, bindings, {
+            offsetof(ASHUtil::FrameDescriptors, ubo),
+            offsetof(ASHUtil::FrameDescriptors, modelMatrices),
+            offsetof(ASHUtil::FrameDescriptors, materialIndices)
+        });
 
         bindings.count = 1;
 
+        // one texture per mesh type, indexed by the material the vertex shader passes down
         bindings.indices[0] = 0;
         bindings.types[0] = vk::DescriptorType::eCombinedImageSampler;
-        bindings.counts[0] = 1;
+        bindings.counts[0] = meshTypeCount;
         bindings.stages[0] = vk::ShaderStageFlagBits::eFragment;
 
         m_meshSetLayout = ASHInit::createDescriptorSetLayout(m_device, bindings);
+
+        // instances, draws, visible instances, indirect commands, visible materials, pending occlusion tests, stats,
+        // camera, depth pyramid
+        ASHInit::DescriptorSetLayoutData cullBindings;
+        cullBindings.count = 9;
+        for (int i = 0; i < cullBindings.count; ++i) {
+            cullBindings.indices.push_back(i);
+            cullBindings.types.push_back(vk::DescriptorType::eStorageBuffer);
+            cullBindings.counts.push_back(1);
+            cullBindings.stages.push_back(vk::ShaderStageFlagBits::eCompute);
+        }
+        cullBindings.types[7] = vk::DescriptorType::eUniformBuffer;
+        cullBindings.types[8] = vk::DescriptorType::eCombinedImageSampler;
+
+        m_cullSetLayout = ASHInit::createDescriptorSetLayout(m_device, cullBindings);
+
+        std::vector<size_t> cullOffsets;
+        for (size_t i = 0; i < 7; ++i) {
+            cullOffsets.push_back(offsetof(ASHUtil::CullDescriptors, buffers) + i * sizeof(vk::DescriptorBufferInfo));
+        }
+        cullOffsets.push_back(offsetof(ASHUtil::CullDescriptors, ubo));
+        cullOffsets.push_back(offsetof(ASHUtil::CullDescriptors, depthPyramid));
+        m_cullUpdateTemplate = ASHInit::createDescriptorUpdateTemplate(m_device, m_cullSetLayout, cullBindings, cullOffsets);
+
+        // source depth, destination level
+        ASHInit::DescriptorSetLayoutData reduceBindings;
+        reduceBindings.count = 2;
+        reduceBindings.indices = {0, 1};
+        reduceBindings.types = {vk::DescriptorType::eCombinedImageSampler, vk::DescriptorType::eStorageImage};
+        reduceBindings.counts = {1, 1};
+        reduceBindings.stages = {vk::ShaderStageFlagBits::eCompute, vk::ShaderStageFlagBits::eCompute};
+
+        m_depthReduceSetLayout = ASHInit::createDescriptorSetLayout(m_device, reduceBindings);
     }
 
     void Engine::createPipeline() {
+        Clock::time_point start = Clock::now();
+        m_pipelines = new ASHUtil::PipelineRegistry(m_device, m_jobs);
+
+        // shaders are embedded in the binary, a directory of freshly compiled ones can stand in for them
+        const char* shaderDirectory = std::getenv("ASH_SHADER_DIR");
+        if (shaderDirectory) {
+            m_config.shaderDirectory = shaderDirectory;
+        }
+        if (!m_config.shaderDirectory.empty()) {
+            std::cout << "Shaders found in " << yellow(m_config.shaderDirectory) << " replace the embedded ones" << std::endl;
+        }
+
+        // layouts and render passes are shared by every variant, so they exist before any pipeline compiles
+        vk::Format depthFormat = m_swapchainFrames[0].depthFormat;
+        m_pipelineLayout = ASHInit::createPipelineLayout(m_device, {m_frameSetLayout, m_meshSetLayout}, {ASHInit::createPushConstantInfo(vk::ShaderStageFlagBits::eVertex, sizeof(ASHUtil::DrawParams))});
+        m_renderPass = ASHInit::createRenderPass(m_device, m_swapchainFormat, depthFormat, ASHInit::renderPassPhases::SINGLE, !m_headless);
+        m_pipelineKey = requestMainPipeline(m_config.shaderFeatures, 0);
+
+        if (m_config.depthPrepass) {
+            ASHInit::GraphicsPipelineInputBundle depthInput{};
+            depthInput.device = m_device;
+            depthInput.pipelineCache = m_pipelineCache->get();
+            depthInput.vertShader = "depth.vert.spv";
+            depthInput.shaderDirectory = m_config.shaderDirectory;
+            depthInput.swapchainImageFormat = m_swapchainFormat;
+            depthInput.depthFormat = depthFormat;
+            depthInput.descriptorSetLayouts = {m_frameSetLayout, m_meshSetLayout};
+            depthInput.pushConstantSize = sizeof(ASHUtil::DrawParams);
+            depthInput.layout = m_pipelineLayout;
+            depthInput.renderPass = m_renderPass;
+            depthInput.present = !m_headless;
+            depthInput.depthMode = ASHInit::depthModes::PREPASS;
+            m_depthPipelineKey = ASHInit::hashGraphicsPipelineState(depthInput);
+            m_pipelines->request(m_depthPipelineKey, "depth pre-pass", [depthInput] { return ASHInit::createGraphicsPipeline(depthInput).pipeline; });
+        }
+
+        ASHInit::ComputePipelineInputBundle cullInput{};
+        cullInput.device = m_device;
+        cullInput.pipelineCache = m_pipelineCache->get();
+        cullInput.shader = "cull.comp.spv";
+        cullInput.shaderDirectory = m_config.shaderDirectory;
+        cullInput.descriptorSetLayouts = {m_cullSetLayout};
+        cullInput.pushConstantSize = sizeof(ASHUtil::CullParams);
+        m_cullPipelineLayout = ASHInit::createComputePipelineLayout(cullInput);
+        cullInput.layout = m_cullPipelineLayout;
+        m_cullPipelineKey = ASHInit::hashComputePipelineState(cullInput);
+        m_pipelines->request(m_cullPipelineKey, "cull", [cullInput] { return ASHInit::createComputePipeline(cullInput).pipeline; });
+
+        ASHInit::ComputePipelineInputBundle reduceInput{};
+        reduceInput.device = m_device;
+        reduceInput.pipelineCache = m_pipelineCache->get();
+        reduceInput.shader = "depthreduce.comp.spv";
+        reduceInput.shaderDirectory = m_config.shaderDirectory;
+        reduceInput.descriptorSetLayouts = {m_depthReduceSetLayout};
+        reduceInput.pushConstantSize = sizeof(ASHImage::DepthReduceParams);
+        m_depthReducePipelineLayout = ASHInit::createComputePipelineLayout(reduceInput);
+        reduceInput.layout = m_depthReducePipelineLayout;
+        m_depthReducePipelineKey = ASHInit::hashComputePipelineState(reduceInput);
+        m_pipelines->request(m_depthReducePipelineKey, "depth reduce", [reduceInput] { return ASHInit::createComputePipeline(reduceInput).pipeline; });
+
+        // compatible with m_renderPass, so the same pipeline draws in both halves
+        if (m_config.occlusionCulling) {
+            m_earlyRenderPass = ASHInit::createRenderPass(m_device, m_swapchainFormat, depthFormat, ASHInit::renderPassPhases::FIRST, !m_headless);
+            m_lateRenderPass = ASHInit::createRenderPass(m_device, m_swapchainFormat, depthFormat, ASHInit::renderPassPhases::LAST, !m_headless);
+        }
+
+        // nothing draws without these, variants requested later have them as placeholders
+        m_pipelines->waitAll();
+
+        // a warm cache skips the driver's shader compilation, which is most of this
+        std::cout << "Pipelines created in " << msBetween(start, Clock::now()) << " ms with a "
+            << (m_pipelineCache->isWarm() ? green("warm") : yellow("cold")) << " cache (" << m_pipelineCache->getStatus() << ")" << std::endl;
+        printPipelineStats();
+    }
+
+    uint64_t Engine::requestMainPipeline(ShaderFeatures features, uint64_t placeholderKey) {
         ASHInit::GraphicsPipelineInputBundle input{};
         input.device = m_device;
-        input.vertFilePath = "shaders/shader.vert.spv";
-        input.fragFilePath = "shaders/shader.frag.spv";
-        input.swapchainExtent = m_swapchainExtent;
+        input.pipelineCache = m_pipelineCache->get();
+        input.vertShader = "shader.vert.spv";
+        input.fragShader = "shader.frag.spv";
+        input.shaderDirectory = m_config.shaderDirectory;
+        // in constant_id order
+        input.vertSpecialization = {m_config.drawPushConstants ? VK_TRUE : VK_FALSE};
+        input.fragSpecialization = {features.texturing ? VK_TRUE : VK_FALSE, features.vertexColor ? VK_TRUE : VK_FALSE};
         input.swapchainImageFormat = m_swapchainFormat;
         input.depthFormat = m_swapchainFrames[0].depthFormat;
         input.descriptorSetLayouts = {m_frameSetLayout, m_meshSetLayout};
-        ASHInit::GraphicsPipelineOutputBundle output = ASHInit::createGraphicsPipeline(input);
-        m_pipeline = output.pipeline;
-        m_pipelineLayout = output.layout;
-        m_renderPass = output.renderPass;
+        input.pushConstantSize = sizeof(ASHUtil::DrawParams);
+        input.layout = m_pipelineLayout;
+        input.renderPass = m_renderPass;
+        input.present = !m_headless;
+        input.depthMode = m_config.depthPrepass ? ASHInit::depthModes::EQUAL : ASHInit::depthModes::WRITE;
+
+        std::string name = std::string("main") + (features.texturing ? " textured" : "") + (features.vertexColor ? " vertex colored" : "");
+        uint64_t key = ASHInit::hashGraphicsPipelineState(input);
+        m_pipelines->request(key, name, [input] { return ASHInit::createGraphicsPipeline(input).pipeline; }, placeholderKey);
+        return key;
+    }
 
+    void Engine::setShaderFeatures(ShaderFeatures features) {
+        if (features == m_config.shaderFeatures) {
+            return;
+        }
+
+        // cached command buffers pick the variant up through the recording key once it replaces the placeholder
+        m_pipelineKey = requestMainPipeline(features, m_pipelineKey);
+        m_config.shaderFeatures = features;
+    }
+
+    void Engine::setDrawPushConstants(bool enabled) {
+        if (enabled == m_config.drawPushConstants) {
+            return;
+        }
+
+        // frames already submitted keep the pipeline and material data they were recorded with
+        m_config.drawPushConstants = enabled;
+        m_multiDrawIndirect = m_capabilities.multiDrawIndirect && !enabled;
+        m_pipelineKey = requestMainPipeline(m_config.shaderFeatures, 0);
+        m_pipelines->waitAll();
+    }
+
+    void Engine::printPipelineStats() const {
+        for (const ASHUtil::PipelineVariantStats& variant : m_pipelines->getStats()) {
+            std::cout << "\t" << variant.name << ": ";
+            if (variant.ready) {
+                std::cout << variant.compileMs << " ms to compile";
+            } else {
+                std::cout << yellow("compiling");
+            }
+            std::cout << ", " << variant.placeholderUses << " placeholder uses" << std::endl;
+        }
     }
 
     void Engine::createFrameResources() {
+        ASHImage::DepthPyramidInput pyramidInput{};
+        pyramidInput.device = m_device;
+        pyramidInput.physicalDevice = m_physicalDevice;
+        pyramidInput.commandBuffer = m_primaryCommandBuffer;
+        pyramidInput.queue = m_graphicsQueue;
+        pyramidInput.timeline = m_timeline;
+        pyramidInput.width = m_swapchainExtent.width;
+        pyramidInput.height = m_swapchainExtent.height;
+        pyramidInput.reduceSetLayout = m_depthReduceSetLayout;
+        for (const ASHUtil::SwapChainFrame& frame : m_swapchainFrames) {
+            pyramidInput.depthViews.push_back(frame.depthBufferView);
+        }
+        m_depthPyramid = new ASHImage::DepthPyramid(pyramidInput);
+        m_historyValid = false;
+
+        for (ASHUtil::InFlightFrame& frame : m_frames) {
+            frame.setDepthPyramid(m_depthPyramid->getDescriptorInfo());
+        }
+    }
+
+    void Engine::createFramesInFlight() {
+        m_frames.resize(m_config.framesInFlight);
+        m_maxFramesInFlight = static_cast<int>(m_frames.size());
+        m_currentFrame = 0;
+
         ASHInit::DescriptorSetLayoutData bindings;
-        bindings.count = 2;
+        bindings.count = 3;
         bindings.types.push_back(vk::DescriptorType::eUniformBuffer);
         bindings.types.push_back(vk::DescriptorType::eStorageBuffer);
-        m_framePool = ASHInit::createDescriptorPool(m_device, static_cast<uint32_t>(m_swapchainFrames.size()), bindings);
+        bindings.types.push_back(vk::DescriptorType::eStorageBuffer);
+        m_framePool = ASHInit::createDescriptorPool(m_device, static_cast<uint32_t>(m_frames.size()), bindings);
+
+        ASHInit::DescriptorSetLayoutData cullBindings;
+        cullBindings.count = 9;
+        cullBindings.types.assign(7, vk::DescriptorType::eStorageBuffer);
+        cullBindings.types.push_back(vk::DescriptorType::eUniformBuffer);
+        cullBindings.types.push_back(vk::DescriptorType::eCombinedImageSampler);
+        m_cullPool = ASHInit::createDescriptorPool(m_device, static_cast<uint32_t>(m_frames.size()), cullBindings);
+
+        ASHInit::CommandBufferInput cbInput = {m_device, m_commandPool, m_frames};
+        ASHInit::createFrameCommandBuffers(cbInput);
+        // sized for every job thread rather than recordingThreads so the benchmark can go through every count
+        ASHInit::createRecordingBuffers(cbInput, m_physicalDevice, m_surface, static_cast<uint32_t>(m_jobs.size()));
 
-        for (ASHUtil::SwapChainFrame& frame: m_swapchainFrames) {
-            frame.inFlightFence = ASHInit::createFence(m_device);
+        for (ASHUtil::InFlightFrame& frame : m_frames) {
+            frame.device = m_device;
+            frame.physicalDevice = m_physicalDevice;
+
+            frame.timelineValue = 0;
             frame.imageAvailableSemaphore = ASHInit::createSemaphore(m_device);
-            frame.renderFinishedSemaphore = ASHInit::createSemaphore(m_device);
 
             frame.createDescriptorResources();
 
             frame.descriptorSet = ASHInit::allocateDescriptorSet(m_device, m_framePool, m_frameSetLayout);
+            frame.cullDescriptorSet = ASHInit::allocateDescriptorSet(m_device, m_cullPool, m_cullSetLayout);
+
+            if (m_capabilities.pipelineStatistics) {
+                vk::QueryPoolCreateInfo statisticsInfo{};
+                statisticsInfo.queryType = vk::QueryType::ePipelineStatistics;
+                statisticsInfo.queryCount = 1;
+                statisticsInfo.pipelineStatistics = vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+                frame.statisticsPool = m_device.createQueryPool(statisticsInfo);
+            }
+            frame.statisticsWritten = false;
+
+            #ifdef BENCHMARK
+            vk::QueryPoolCreateInfo queryInfo{};
+            queryInfo.queryType = vk::QueryType::eTimestamp;
+            queryInfo.queryCount = 2;
+            frame.timestampPool = m_device.createQueryPool(queryInfo);
+            frame.timestampsWritten = false;
+            #endif
+        }
+
+        createCommandCache();
+
+        // none of the images are waited on by the old slots anymore
+        m_imagesInFlight.assign(m_swapchainFrames.size(), 0);
+    }
+
+    void Engine::createCommandCache() {
+        if (!m_config.cacheCommandBuffers) {
+            return;
         }
+
+        ASHInit::CommandBufferInput cbInput = {m_device, m_commandPool, m_frames};
+        ASHInit::createCachedCommandBuffers(cbInput, static_cast<uint32_t>(m_swapchainFrames.size()));
+    }
+
+    void Engine::destroyCommandCache() {
+        for (ASHUtil::InFlightFrame& frame : m_frames) {
+            if (!frame.cachedCommandBuffers.empty()) {
+                m_device.freeCommandBuffers(m_commandPool, frame.cachedCommandBuffers);
+            }
+            frame.cachedCommandBuffers.clear();
+            frame.cachedKeys.clear();
+        }
+    }
+
+    uint64_t Engine::getRecordingKey(const ASHUtil::InFlightFrame& frame) const {
+        // everything recordCommands bakes in besides the slot's buffers and the image's framebuffer, which a
+        // cached buffer is tied to anyway, the commands and instances those buffers hold are rewritten every frame
+        uint32_t counts[] = {m_drawBatch.size(), m_lateDrawBatch.size(), frame.cullInstanceCount, frame.drawCount, m_historyValid ? 1u : 0u};
+        uint64_t key = ASHUtil::hashState(ASHUtil::stateHashSeed, counts, sizeof(counts));
+
+        // per draw push constants, the visible mesh types can change while the number of draws stays the same
+        if (m_config.drawPushConstants) {
+            key = m_lateDrawBatch.hash(m_drawBatch.hash(key));
+        }
+
+        // culling push constants
+        if (m_config.culling == cullingModes::GPU) {
+            key = ASHUtil::hashState(key, m_culler.getPlanes(), sizeof(ASHUtil::CullParams::planes));
+        }
+
+        // a placeholder is replaced once its variant finishes compiling
+        vk::Pipeline pipelines[] = {m_pipelines->resolve(m_pipelineKey), m_depthPipelineKey != 0 ? m_pipelines->resolve(m_depthPipelineKey) : vk::Pipeline()};
+        key = ASHUtil::hashState(key, pipelines, sizeof(pipelines));
+
+        return key == 0 ? 1 : key;
+    }
+
+    void Engine::destroyFramesInFlight() {
+        destroyCommandCache();
+
+        for (ASHUtil::InFlightFrame& frame : m_frames) {
+            m_device.freeCommandBuffers(m_commandPool, frame.commandBuffer);
+            frame.destroy();
+        }
+        m_frames.clear();
+
+        m_device.destroyDescriptorPool(m_framePool);
+        m_device.destroyDescriptorPool(m_cullPool);
+    }
+
+    void Engine::setFramesInFlight(uint32_t count) {
+        m_timeline->wait(m_timeline->getLastSubmitted());
+
+        destroyFramesInFlight();
+        m_config.framesInFlight = std::clamp(count, 1u, 4u);
+
+        // headless targets are one per slot, the framebuffers, depth pyramid and command cache follow their count
+        if (m_headless) {
+            destroySwapchain();
+            m_swapchainFrames.clear();
+            createOffscreenTargets();
+            createFramebuffers();
+            createFramesInFlight();
+            createFrameResources();
+            return;
+        }
+
+        createFramesInFlight();
+
+        for (ASHUtil::InFlightFrame& frame : m_frames) {
+            frame.setDepthPyramid(m_depthPyramid->getDescriptorInfo());
+        }
+        m_historyValid = false;
     }
 
     void Engine::finishSetup() {
@@ -181,10 +676,10 @@ namespace ASH {
 
         m_commandPool = ASHInit::createCommandPool(m_device, m_physicalDevice, m_surface);
 
-        ASHInit::CommandBufferInput cbInput = {m_device, m_commandPool, m_swapchainFrames};
+        ASHInit::CommandBufferInput cbInput = {m_device, m_commandPool, m_frames};
         m_primaryCommandBuffer = ASHInit::createCommandBuffer(cbInput);
-        ASHInit::createFrameCommandBuffers(cbInput);
 
+        createFramesInFlight();
         createFrameResources();
     }
 
@@ -209,44 +704,97 @@ namespace ASH {
         };
 
 
-        for (std::pair<meshTypes, std::vector<const char*>> pair : modelPaths) {
-            ASHModel::Obj model(pair.second[0], pair.second[1], glm::mat4(1.f));
-            m_meshes->consume(pair.first, model.vertices, model.indices);
-        }
-
-        FinalizationChunk finalizationInfo{};
-        finalizationInfo.device = m_device;
-        finalizationInfo.physicalDevice = m_physicalDevice;
-        finalizationInfo.queue = m_graphicsQueue;
-        finalizationInfo.commandBuffer = m_primaryCommandBuffer;
-        m_meshes->finalize(finalizationInfo);
-
         std::unordered_map<meshTypes, const char*> filenames = {
             {meshTypes::GROUND, "models/quad.jpg"},
             {meshTypes::VOXEL, "models/voxel.png"},
             {meshTypes::SKULL, "models/skull.png"}
         };
 
-        
-        ASHInit::DescriptorSetLayoutData bindings;
-        bindings.count = 1;
-        bindings.types.push_back(vk::DescriptorType::eCombinedImageSampler);
+        // every file is parsed or decoded on its own job, the meshes are merged and uploaded by one more once all
+        // of them are loaded, the textures are uploaded here after that since both go through the transfer queue
+        std::vector<std::pair<meshTypes, std::unique_ptr<ASHModel::Obj>>> models;
+        for (const auto& [type, paths] : modelPaths) {
+            models.push_back({type, nullptr});
+        }
+        std::vector<std::pair<meshTypes, ASHImage::TextureData>> textures;
+        for (const auto& [type, filename] : filenames) {
+            textures.push_back({type, ASHImage::TextureData{}});
+        }
+
+        ASHUtil::JobCounter loaded, meshesReady;
+        for (auto& [type, model] : models) {
+            const std::vector<const char*>& paths = modelPaths[type];
+            m_jobs.run([&model, &paths] {
+                model = std::make_unique<ASHModel::Obj>(paths[0], paths[1], glm::mat4(1.f));
+            }, loaded);
+        }
+        for (auto& [type, texture] : textures) {
+            const char* filename = filenames[type];
+            m_jobs.run([&texture, filename] { texture = ASHImage::decodeTexture(filename); }, loaded);
+        }
+
+        m_jobs.run([this, &models] {
+            // a file that failed to load is rethrown by the wait on loaded
+            for (const auto& [type, model] : models) {
+                if (!model) {
+                    return;
+                }
+            }
+
+            for (const auto& [type, model] : models) {
+                m_meshes->consume(type, model->vertices, model->indices);
+            }
+
+            FinalizationChunk finalizationInfo{};
+            finalizationInfo.device = m_device;
+            finalizationInfo.physicalDevice = m_physicalDevice;
+            finalizationInfo.transfer = m_transfer;
+            m_meshes->finalize(finalizationInfo);
+        }, meshesReady, loaded);
 
-        m_meshPool = ASHInit::createDescriptorPool(m_device, static_cast<uint32_t>(filenames.size()), bindings);
+        // meshesReady can't finish before loaded, so nothing the jobs captured is still in use if either throws
+        m_jobs.wait(meshesReady);
+        m_jobs.wait(loaded);
+
+        // large meshes hide the most for the fewest triangles, the ground is always one
+        for (const auto& [type, bounds] : m_meshes->m_bounds) {
+            m_occluders[type] = type == meshTypes::GROUND || glm::length(bounds.max - bounds.min) >= m_config.occluderSize;
+        }
 
         ASHImage::TextureInput input{};
-        input.commandBuffer = m_primaryCommandBuffer;
-        input.queue = m_graphicsQueue;
+        input.transfer = m_transfer;
         input.device = m_device;
         input.physicalDevice = m_physicalDevice;
-        input.layout = m_meshSetLayout;
-        input.pool = m_meshPool;
 
-        for (const auto & [object, filename] : filenames) {
-            input.path = filename;
+        for (auto& [object, texture] : textures) {
+            input.path = filenames[object];
+            input.data = &texture;
             m_materials[object] = new ASHImage::Texture(input);
         }
 
+        // a single set holds every material, bound once per frame
+        ASHInit::DescriptorSetLayoutData bindings;
+        bindings.count = meshTypeCount;
+        bindings.types.assign(meshTypeCount, vk::DescriptorType::eCombinedImageSampler);
+
+        m_meshPool = ASHInit::createDescriptorPool(m_device, 1, bindings);
+        m_materialSet = ASHInit::allocateDescriptorSet(m_device, m_meshPool, m_meshSetLayout);
+
+        std::array<vk::DescriptorImageInfo, meshTypeCount> imageInfos;
+        for (const auto& [type, texture] : m_materials) {
+            imageInfos[static_cast<uint32_t>(type)] = texture->getDescriptorInfo();
+        }
+
+        vk::WriteDescriptorSet writeInfo;
+        writeInfo.dstSet = m_materialSet;
+        writeInfo.dstBinding = 0;
+        writeInfo.dstArrayElement = 0;
+        writeInfo.descriptorCount = meshTypeCount;
+        writeInfo.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        writeInfo.pImageInfo = imageInfos.data();
+
+        m_device.updateDescriptorSets(writeInfo, nullptr);
+
         #ifdef DEBUG
         std::cout << green("Assets loaded") << std::endl;
         #endif
@@ -259,9 +807,7 @@ namespace ASH {
         commandBuffer.bindIndexBuffer(m_meshes->m_indexBuffer.buffer, 0, vk::IndexType::eUint32);
     }
 
-    void Engine::prepFrame(uint32_t imageIndex, Scene *scene) {
-
-        ASHUtil::SwapChainFrame& _frame = m_swapchainFrames[imageIndex];
+    void Engine::prepFrame(ASHUtil::InFlightFrame& _frame, const Scene *scene) {
 
         glm::vec3 eye = { -10.0f, 0.0f, 10.0f };
         glm::vec3 center = { 0.f, 0.0f, 0.0f };
@@ -276,23 +822,183 @@ namespace ASH {
         _frame.cameraData.view = view;
         _frame.cameraData.projection = projection;
         _frame.cameraData.viewProjection = projection * view; // premul for performance
+        _frame.cameraData.previousViewProjection = m_historyValid ? m_lastViewProjection : _frame.cameraData.viewProjection;
+        m_lastViewProjection = _frame.cameraData.viewProjection;
 
         memcpy(_frame.cameraDataWritePtr, &_frame.cameraData, sizeof(ASHUtil::UBO));
 
-        size_t i = 0;
+        m_transforms.clear();
 
-        for (std::pair<meshTypes, std::vector<glm::vec3>> pair : scene->positions) {
-            for (glm::vec3& position : pair.second) {
-                _frame.modelMatrices[i++] = glm::translate(glm::mat4(1.0f), position);
+        for (const auto& [type, positions] : scene->positions) {
+            for (const glm::vec3& position : positions) {
+                m_transforms.push_back({position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f)});
             }
         }
 
-        memcpy(_frame.modelMatrixWritePtr, _frame.modelMatrices.data(), i * sizeof(glm::mat4));
+        // the slot's last submission has finished, so its instance buffers can be swapped for larger ones
+        _frame.reserveInstances(static_cast<uint32_t>(m_transforms.size()));
+
+        m_instanceMatrices.resize(m_transforms.size());
+        m_jobs.parallelFor(m_transforms.size(), 256, [this](size_t begin, size_t end) {
+            ASHMath::composeTransforms(m_transforms.data() + begin, m_instanceMatrices.data() + begin, end - begin);
+        });
 
-        _frame.writeDescriptorSet();
+        m_culler.setFrustum(_frame.cameraData.viewProjection);
+
+        if (m_config.culling == cullingModes::GPU) {
+            prepGpuCulling(_frame, scene);
+        } else {
+            cullOnCpu(_frame, scene);
+        }
+
+        _frame.updateDescriptorSets(m_frameUpdateTemplate, m_cullUpdateTemplate);
+    }
+
+    void Engine::cullOnCpu(ASHUtil::InFlightFrame& frame, const Scene *scene) {
+        // only visible instances are compacted into the instance buffer, each mesh type gets one command over its range
+        m_drawBatch.clear();
+
+        // frustum pass, each type's survivors land in their own range of the frame's matrices
+        std::vector<std::pair<meshTypes, uint32_t>> ranges;
+        size_t first = 0;
+        uint32_t inFrustum = 0;
+        for (const auto& [type, positions] : scene->positions) {
+            uint32_t count = m_culler.cull(m_instanceMatrices.data() + first, positions.size(), m_meshes->m_bounds[type], frame.modelMatrices.data() + inFrustum, m_jobs);
+            ranges.push_back({type, count});
+
+            first += positions.size();
+            inFrustum += count;
+        }
+
+        if (m_config.softwareOcclusion) {
+            m_occlusion.begin(frame.cameraData.viewProjection);
+
+            uint32_t offset = 0;
+            for (const auto& [type, count] : ranges) {
+                if (m_occluders[type]) {
+                    m_occlusion.addOccluder(m_meshes->m_positions[type], m_meshes->m_localIndices[type], frame.modelMatrices.data() + offset, count);
+                }
+                offset += count;
+            }
+
+            m_occlusion.rasterize(m_jobs);
+        }
+
+        // occlusion pass, occluders themselves are never tested so they can't hide behind each other
+        uint32_t offset = 0;
+        uint32_t visible = 0;
+        for (const auto& [type, count] : ranges) {
+            glm::mat4* range = frame.modelMatrices.data() + offset;
+            uint32_t kept = count;
+            if (m_config.softwareOcclusion && !m_occluders[type]) {
+                kept = m_occlusion.cull(range, count, m_meshes->m_bounds[type], m_jobs);
+            }
+
+            if (visible != offset) {
+                memmove(frame.modelMatrices.data() + visible, range, kept * sizeof(glm::mat4));
+            }
+            if (!m_config.drawPushConstants) {
+                std::fill_n(frame.materialIndices.begin() + visible, kept, static_cast<uint32_t>(type));
+            }
+
+            if (kept > 0) {
+                m_drawBatch.add(m_meshes->m_indexCounts[type], m_meshes->m_firstIndices[type], visible, kept, static_cast<uint32_t>(type));
+            }
+
+            offset += count;
+            visible += kept;
+        }
+
+        m_stats.totalInstances = static_cast<uint32_t>(first);
+        m_stats.visibleInstances = visible;
+        m_stats.occludedInstances = inFrustum - visible;
+
+        #ifdef BENCHMARK
+        if (m_config.softwareOcclusion) {
+            const ASHUtil::OcclusionMetrics& metrics = m_occlusion.getMetrics();
+            m_occlusionTotals.occluderTriangles += metrics.occluderTriangles;
+            m_occlusionTotals.testedInstances += metrics.testedInstances;
+            m_occlusionTotals.occludedInstances += metrics.occludedInstances;
+            m_occlusionTotals.rasterizeMs += metrics.rasterizeMs;
+            m_occlusionTotals.testMs += metrics.testMs;
+            m_occlusionTotals.referenceMs += metrics.referenceMs;
+            m_occlusionTotals.falseOccluded += metrics.falseOccluded;
+            m_occlusionTotals.missedOccluded += metrics.missedOccluded;
+
+            if (++m_occlusionFrames == 256) {
+                double frames = m_occlusionFrames;
+                std::cout << "Software occlusion over " << m_occlusionFrames << " frames on " << m_jobs.size() << " threads: "
+                    << (m_occlusionTotals.rasterizeMs + m_occlusionTotals.testMs) / frames << " ms/frame ("
+                    << m_occlusionTotals.rasterizeMs / frames << " raster, " << m_occlusionTotals.testMs / frames << " test), reference "
+                    << m_occlusionTotals.referenceMs / frames << " ms/frame, "
+                    << m_occlusionTotals.occludedInstances << "/" << m_occlusionTotals.testedInstances << " occluded, "
+                    << m_occlusionTotals.falseOccluded << " false positives, " << m_occlusionTotals.missedOccluded << " missed" << std::endl;
+                m_occlusionTotals = ASHUtil::OcclusionMetrics();
+                m_occlusionFrames = 0;
+            }
+        }
+        #endif
+
+        memcpy(frame.modelMatrixWritePtr, frame.modelMatrices.data(), visible * sizeof(glm::mat4));
+        if (!m_config.drawPushConstants) {
+            memcpy(frame.materialIndexWritePtr, frame.materialIndices.data(), visible * sizeof(uint32_t));
+        }
+
+        m_drawBatch.upload(frame.indirectWritePtr);
+        frame.drawCount = m_drawBatch.size();
     }
 
-    void Engine::recordCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene *scene) {
+    void Engine::prepGpuCulling(ASHUtil::InFlightFrame& frame, const Scene *scene) {
+        ASHUtil::CullInstance* instances = static_cast<ASHUtil::CullInstance*>(frame.cullInstanceWritePtr);
+        ASHUtil::CullDraw* draws = static_cast<ASHUtil::CullDraw*>(frame.cullDrawWritePtr);
+        vk::DrawIndexedIndirectCommand* commands = static_cast<vk::DrawIndexedIndirectCommand*>(frame.indirectWritePtr);
+
+        // the commands still hold the counts the compute pass produced the last time this ring slot was used
+        uint32_t commandCount = m_config.occlusionCulling ? 2 * frame.drawCount : frame.drawCount;
+        uint32_t visible = 0;
+        for (uint32_t i = 0; i < commandCount; ++i) {
+            visible += commands[i].instanceCount;
+        }
+        m_stats.visibleInstances = visible;
+
+        uint32_t* occluded = static_cast<uint32_t*>(frame.cullStatsWritePtr);
+        m_stats.occludedInstances = *occluded;
+        *occluded = 0;
+
+        // one indirect command per mesh type, instanceCount is filled by the compute pass
+        // the late occlusion phase compacts into its own range after every instance of the early one
+        m_drawBatch.clear();
+        m_lateDrawBatch.clear();
+        uint32_t lateBase = static_cast<uint32_t>(m_instanceMatrices.size());
+
+        uint32_t instance = 0;
+        for (const auto& [type, positions] : scene->positions) {
+            uint32_t drawIndex = m_drawBatch.add(m_meshes->m_indexCounts[type], m_meshes->m_firstIndices[type], instance, 0, static_cast<uint32_t>(type));
+            if (m_config.occlusionCulling) {
+                m_lateDrawBatch.add(m_meshes->m_indexCounts[type], m_meshes->m_firstIndices[type], lateBase + instance, 0, static_cast<uint32_t>(type));
+            }
+
+            const ASHMath::AABB& bounds = m_meshes->m_bounds[type];
+            draws[drawIndex].boundsMin = glm::vec4(bounds.min, 0.0f);
+            draws[drawIndex].boundsMax = glm::vec4(bounds.max, 0.0f);
+            draws[drawIndex].material = static_cast<uint32_t>(type);
+
+            for (size_t i = 0; i < positions.size(); ++i) {
+                instances[instance].model = m_instanceMatrices[instance];
+                instances[instance].drawIndex = drawIndex;
+                ++instance;
+            }
+        }
+
+        m_drawBatch.upload(commands);
+        m_lateDrawBatch.upload(commands + m_drawBatch.size());
+
+        frame.cullInstanceCount = instance;
+        frame.drawCount = m_drawBatch.size();
+        m_stats.totalInstances = instance;
+    }
+
+    void Engine::recordCommands(ASHUtil::InFlightFrame& frame, vk::CommandBuffer commandBuffer, uint32_t imageIndex, const Scene *scene) {
         vk::CommandBufferBeginInfo beginInfo{};
 
         try {
@@ -301,12 +1007,101 @@ namespace ASH {
             throw std::runtime_error("Failed to begin recording command buffer");
         }
 
+        // anything uploaded since the last frame becomes usable here
+        frame.uploadWait = m_transfer->recordAcquires(commandBuffer);
+
+        // spans every pass, culling dispatches run no fragment shaders
+        if (frame.statisticsPool) {
+            commandBuffer.resetQueryPool(frame.statisticsPool, 0, 1);
+            commandBuffer.beginQuery(frame.statisticsPool, 0, vk::QueryControlFlags());
+        }
+
+        #ifdef BENCHMARK
+        if (m_timestampPeriod > 0.0f) {
+            commandBuffer.resetQueryPool(frame.timestampPool, 0, 2);
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.timestampPool, 0);
+        }
+        #endif
+
+        bool gpuCulling = m_config.culling == cullingModes::GPU;
+        vk::DeviceSize lateOffset = m_drawBatch.size() * sizeof(vk::DrawIndexedIndirectCommand);
+
+        if (!gpuCulling) {
+            recordPass(frame, commandBuffer, imageIndex, m_renderPass, m_drawBatch, 0, 0);
+        } else if (!m_config.occlusionCulling) {
+            recordCulling(frame, commandBuffer, ASHUtil::cullPhases::FRUSTUM);
+            recordPass(frame, commandBuffer, imageIndex, m_renderPass, m_drawBatch, 0, 0);
+        } else {
+            // the pyramid is shared by every ring slot, the previous submission built it and may still be reading it
+            vk::MemoryBarrier pyramidBarrier{};
+            pyramidBarrier.srcAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+            pyramidBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), pyramidBarrier, nullptr, nullptr);
+
+            // draw what survives against last frame's depth, then re-test the rest against what was just drawn
+            recordCulling(frame, commandBuffer, ASHUtil::cullPhases::EARLY);
+            recordPass(frame, commandBuffer, imageIndex, m_earlyRenderPass, m_drawBatch, 0, 0);
+
+            recordDepthPyramid(commandBuffer, imageIndex);
+            recordCulling(frame, commandBuffer, ASHUtil::cullPhases::LATE);
+
+            vk::ImageMemoryBarrier depthBarrier = createDepthBarrier(imageIndex, vk::ImageLayout::eDepthStencilReadOnlyOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+            depthBarrier.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+            depthBarrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+            vk::MemoryBarrier colorBarrier{};
+            colorBarrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+            colorBarrier.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+
+            commandBuffer.pipelineBarrier(
+                vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                vk::DependencyFlags(), colorBarrier, nullptr, depthBarrier
+            );
+
+            recordPass(frame, commandBuffer, imageIndex, m_lateRenderPass, m_lateDrawBatch, lateOffset, 1);
+
+            // the next frame's early phase tests against everything drawn in this one
+            recordDepthPyramid(commandBuffer, imageIndex);
+            m_historyValid = true;
+        }
+
+        if (gpuCulling) {
+            // the visible and occluded counts are read back on the host when this frame comes around again
+            vk::MemoryBarrier barrier{};
+            barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), barrier, nullptr, nullptr);
+        }
+
+        if (frame.statisticsPool) {
+            commandBuffer.endQuery(frame.statisticsPool, 0);
+            frame.statisticsWritten = true;
+        }
+
+        #ifdef BENCHMARK
+        if (m_timestampPeriod > 0.0f) {
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame.timestampPool, 1);
+            frame.timestampsWritten = true;
+        }
+        #endif
+
+        try {
+            commandBuffer.end();
+        } catch (vk::SystemError err) {
+            throw std::runtime_error("Failed to end recording command buffer");
+        }
+    }
+
+    void Engine::recordPass(ASHUtil::InFlightFrame& frame, vk::CommandBuffer commandBuffer, uint32_t imageIndex, vk::RenderPass renderPass, const ASHUtil::DrawBatch& batch, vk::DeviceSize indirectOffset, uint32_t pass) {
+
         vk::RenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.renderPass = m_renderPass;
+        renderPassInfo.renderPass = renderPass;
         renderPassInfo.framebuffer = m_swapchainFrames[imageIndex].framebuffer;
         renderPassInfo.renderArea.offset = vk::Offset2D{0, 0};
         renderPassInfo.renderArea.extent = m_swapchainExtent;
 
+        // ignored by passes that load their attachments
         vk::ClearValue colorClear;
         std::array<float, 4> colors = { 0.2f,0.2f,0.2f, 1.0f };
         colorClear.color = vk::ClearColorValue(colors);
@@ -317,118 +1112,466 @@ namespace ASH {
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+        uint32_t threads = getRecordingThreads(batch.size(), m_multiDrawIndirect);
+        commandBuffer.beginRenderPass(renderPassInfo, threads > 1 ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
 
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline);
+        // depth only first, so the shaded draws below only pass the depth test where they end up visible
+        if (m_depthPipelineKey != 0) {
+            recordDraws(frame, commandBuffer, ASHUtil::maxRecordedPasses / 2 + pass, renderPassInfo, batch, frame.indirectBuffer.buffer, indirectOffset, threads, m_multiDrawIndirect, m_depthPipelineKey);
+        }
+        recordDraws(frame, commandBuffer, pass, renderPassInfo, batch, frame.indirectBuffer.buffer, indirectOffset, threads, m_multiDrawIndirect, m_pipelineKey);
 
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout, 0, m_swapchainFrames[imageIndex].descriptorSet, nullptr);
+        commandBuffer.endRenderPass();
+    }
 
-        prepScene(commandBuffer);
+    uint32_t Engine::getRecordingThreads(uint32_t drawCount, bool multiDrawIndirect) const {
+        // a multi-draw is one call however many commands it covers, splitting it only adds secondary buffers
+        uint32_t calls = multiDrawIndirect ? 1 : drawCount;
+        return std::clamp(calls / m_config.drawsPerRecordingThread, 1u, m_config.recordingThreads);
+    }
 
-        uint32_t startInstance = 0;
-        for (std::pair<meshTypes, std::vector<glm::vec3>> pair : scene->positions) {
-            renderObjects(commandBuffer, pair.first, startInstance, static_cast<uint32_t>(pair.second.size()));
+    void Engine::recordDraws(ASHUtil::InFlightFrame& frame, vk::CommandBuffer commandBuffer, uint32_t pass, const vk::RenderPassBeginInfo& renderPassInfo, const ASHUtil::DrawBatch& batch, vk::Buffer indirectBuffer, vk::DeviceSize indirectOffset, uint32_t threads, bool multiDrawIndirect, uint64_t pipelineKey) {
+        if (threads <= 1) {
+            recordDrawRange(commandBuffer, frame, batch, indirectBuffer, indirectOffset, 0, batch.size(), multiDrawIndirect, pipelineKey);
+            return;
         }
 
-        commandBuffer.endRenderPass();
+        threads = std::min(threads, static_cast<uint32_t>(frame.recordingPools.size()));
+        std::vector<vk::CommandBuffer> secondaryBuffers(threads);
 
-        try {
-            commandBuffer.end();
-        } catch (vk::SystemError err) {
-            throw std::runtime_error("Failed to end recording command buffer");
+        vk::CommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.renderPass = renderPassInfo.renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = renderPassInfo.framebuffer;
+        // the primary's statistics query stays active while they execute
+        if (frame.statisticsPool) {
+            inheritanceInfo.pipelineStatistics = vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
         }
+
+        vk::CommandBufferBeginInfo beginInfo{};
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        // each index owns one recording pool, so no pool is touched by two threads even when one thread takes several
+        m_jobs.parallelFor(threads, 1, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                uint32_t first = static_cast<uint32_t>(batch.size() * t / threads);
+                uint32_t last = static_cast<uint32_t>(batch.size() * (t + 1) / threads);
+
+                vk::CommandBuffer secondary = frame.secondaryBuffers[t][pass];
+                try {
+                    secondary.begin(beginInfo);
+                } catch (vk::SystemError err) {
+                    throw std::runtime_error("Failed to begin recording secondary command buffer");
+                }
+
+                recordDrawRange(secondary, frame, batch, indirectBuffer, indirectOffset, first, last - first, multiDrawIndirect, pipelineKey);
+
+                try {
+                    secondary.end();
+                } catch (vk::SystemError err) {
+                    throw std::runtime_error("Failed to end recording secondary command buffer");
+                }
+                secondaryBuffers[t] = secondary;
+            }
+        });
+
+        commandBuffer.executeCommands(secondaryBuffers);
     }
 
-    void Engine::renderObjects(vk::CommandBuffer commandBuffer, meshTypes type, uint32_t& startInstance, uint32_t instanceCount) {
-        
+    void Engine::recordDrawRange(vk::CommandBuffer commandBuffer, ASHUtil::InFlightFrame& frame, const ASHUtil::DrawBatch& batch, vk::Buffer indirectBuffer, vk::DeviceSize indirectOffset, uint32_t first, uint32_t count, bool multiDrawIndirect, uint64_t pipelineKey) {
+        // secondary command buffers inherit no state from the primary one
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipelines->get(pipelineKey));
+        commandBuffer.setViewport(0, ASHInit::createViewport(m_swapchainExtent));
+        commandBuffer.setScissor(0, ASHInit::createScissor(m_swapchainExtent));
 
-        int indexCount = m_meshes->m_indexCounts.find(type)->second;
-        int firstIndex = m_meshes->m_firstIndices.find(type)->second;
+        std::array<vk::DescriptorSet, 2> descriptorSets = {frame.descriptorSet, m_materialSet};
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout, 0, descriptorSets, nullptr);
 
-        
+        prepScene(commandBuffer);
 
-        m_materials[type]->use(commandBuffer, m_pipelineLayout);
+        if (m_config.drawPushConstants) {
+            batch.recordRangeWithParams(commandBuffer, indirectBuffer, indirectOffset, m_pipelineLayout, first, count);
+        } else {
+            batch.recordRange(commandBuffer, indirectBuffer, indirectOffset, multiDrawIndirect, first, count);
+        }
+    }
 
-        
-        commandBuffer.drawIndexed(indexCount, instanceCount, firstIndex, 0, startInstance);
+    void Engine::recordCulling(ASHUtil::InFlightFrame& frame, vk::CommandBuffer commandBuffer, ASHUtil::cullPhases phase) {
+
+        ASHUtil::CullParams params{};
+        memcpy(params.planes, m_culler.getPlanes(), sizeof(params.planes));
+        params.instanceCount = frame.cullInstanceCount;
+        params.drawCount = frame.drawCount;
+        params.phase = phase;
+        params.historyValid = m_historyValid ? 1 : 0;
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipelines->get(m_cullPipelineKey));
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_cullPipelineLayout, 0, frame.cullDescriptorSet, nullptr);
+        commandBuffer.pushConstants(m_cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(ASHUtil::CullParams), &params);
+        commandBuffer.dispatch((params.instanceCount + 63) / 64, 1, 1);
+
+        // the late phase reads what the early one left pending
+        vk::MemoryBarrier barrier{};
+        barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead;
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), barrier, nullptr, nullptr
+        );
+    }
 
-        
-        startInstance += instanceCount;
+    void Engine::recordDepthPyramid(vk::CommandBuffer commandBuffer, uint32_t imageIndex) {
+        vk::ImageMemoryBarrier barrier = createDepthBarrier(imageIndex, vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+        barrier.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), nullptr, nullptr, barrier
+        );
+
+        m_depthPyramid->build(commandBuffer, m_pipelines->get(m_depthReducePipelineKey), m_depthReducePipelineLayout, imageIndex);
     }
 
-    void Engine::render(Scene *scene) {
-        m_device.waitForFences(1, &(m_swapchainFrames[m_currentFrame].inFlightFence), VK_TRUE, UINT64_MAX);
-        m_device.resetFences(1, &(m_swapchainFrames[m_currentFrame].inFlightFence));
+    vk::ImageMemoryBarrier Engine::createDepthBarrier(uint32_t imageIndex, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
+        ASHUtil::SwapChainFrame& frame = m_swapchainFrames[imageIndex];
 
+        // layout transitions of combined formats have to cover the stencil aspect too
+        vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eDepth;
+        if (frame.depthFormat == vk::Format::eD24UnormS8Uint) {
+            aspect |= vk::ImageAspectFlagBits::eStencil;
+        }
 
-        uint32_t imageIndex;
-        try {
-            vk::ResultValue acquire = m_device.acquireNextImageKHR(m_swapchain, UINT64_MAX, m_swapchainFrames[m_currentFrame].imageAvailableSemaphore, nullptr);
-            imageIndex = acquire.value;
-        } catch (vk::OutOfDateKHRError) {
-            recreateSwapchain();
+        vk::ImageMemoryBarrier barrier;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = frame.depthBuffer;
+        barrier.subresourceRange = vk::ImageSubresourceRange(aspect, 0, 1, 0, 1);
+        return barrier;
+    }
+
+    void Engine::readFragmentInvocations(ASHUtil::InFlightFrame& frame) {
+        if (!frame.statisticsPool || !frame.statisticsWritten) {
             return;
-        } catch (vk::SystemError err) {
-            throw std::runtime_error("Failed to acquire swap chain image");
         }
 
-        vk::CommandBuffer commandBuffer = m_swapchainFrames[m_currentFrame].commandBuffer;
+        uint64_t invocations = 0;
+        vk::Result result = m_device.getQueryPoolResults(
+            frame.statisticsPool, 0, 1, sizeof(invocations), &invocations, sizeof(uint64_t), vk::QueryResultFlagBits::e64
+        );
+        if (result == vk::Result::eSuccess) {
+            m_stats.fragmentInvocations = invocations;
+        }
+    }
 
-        commandBuffer.reset();
+    void Engine::render(const Scene *scene) {
+        ASHUtil::InFlightFrame& frame = m_frames[m_currentFrame];
 
-        prepFrame(imageIndex, scene);
+        if (m_config.presentMode == presentModes::FIFO_LIMITED) {
+            limitFrameRate();
+        }
 
-        recordCommands(commandBuffer, imageIndex, scene);
+        Clock::time_point frameStart = Clock::now();
 
-        vk::SubmitInfo submitInfo{};
-        vk::Semaphore waitSemaphores[] = {m_swapchainFrames[m_currentFrame].imageAvailableSemaphore};
-        vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-        vk::Semaphore signalSemaphores[] = {m_swapchainFrames[m_currentFrame].renderFinishedSemaphore};
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+        // everything the slot's last submission read is free again once the timeline passes its value
+        m_timeline->wait(frame.timelineValue);
+        m_timeline->collect();
+        frame.resetRecordingPools();
+        m_transfer->getTimeline().collect();
+        readFragmentInvocations(frame);
 
-        
+        #ifdef BENCHMARK
+        Clock::time_point waited = Clock::now();
+        double gpuMs = readGpuTime(frame);
+        #endif
 
-        try {
-            m_graphicsQueue.submit(submitInfo, m_swapchainFrames[m_currentFrame].inFlightFence);
-        } catch (vk::SystemError err) {
-            throw std::runtime_error("Failed to submit draw command buffer");
+        uint32_t imageIndex;
+        if (m_headless) {
+            imageIndex = m_nextOffscreenImage;
+            m_nextOffscreenImage = (m_nextOffscreenImage + 1) % static_cast<uint32_t>(m_swapchainFrames.size());
+        } else {
+            try {
+                vk::ResultValue acquire = m_device.acquireNextImageKHR(m_swapchain, UINT64_MAX, frame.imageAvailableSemaphore, nullptr);
+                imageIndex = acquire.value;
+            } catch (vk::OutOfDateKHRError) {
+                recreateSwapchain();
+                #ifdef BENCHMARK
+                recordTimings(frameStart, msBetween(frameStart, waited), msBetween(waited, Clock::now()), gpuMs);
+                #endif
+                return;
+            } catch (vk::SystemError err) {
+                throw std::runtime_error("Failed to acquire swap chain image");
+            }
         }
 
-        
+        // with more slots than images, or images handed out out of order, another slot may still be rendering to it
+        m_timeline->wait(m_imagesInFlight[imageIndex]);
 
-        vk::PresentInfoKHR presentInfo{};
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
-        vk::SwapchainKHR swapChains[] = {m_swapchain};
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = swapChains;
-        presentInfo.pImageIndices = &imageIndex;
+        prepFrame(frame, scene);
 
-        vk::Result presentResult;
-        try {
-            presentResult = m_presentQueue.presentKHR(presentInfo);
-        } catch (vk::OutOfDateKHRError) {
-            presentResult = vk::Result::eErrorOutOfDateKHR;
-        } catch (vk::SystemError err) {
-            throw std::runtime_error("Failed to present swap chain image");
+        vk::CommandBuffer commandBuffer = frame.commandBuffer;
+        if (m_config.cacheCommandBuffers) {
+            commandBuffer = frame.cachedCommandBuffers[imageIndex];
+
+            // acquire barriers are only recorded by the one frame that picks the uploads up, so that buffer can't be replayed
+            uint64_t key = m_transfer->hasPendingAcquires() ? 0 : getRecordingKey(frame);
+            if (key == 0 || frame.cachedKeys[imageIndex] != key) {
+                commandBuffer.reset();
+                recordCommands(frame, commandBuffer, imageIndex, scene);
+                frame.cachedKeys[imageIndex] = key;
+                ++m_stats.recordedFrames;
+            } else {
+                frame.uploadWait = ASHUtil::SubmitWait{};
+            }
+        } else {
+            commandBuffer.reset();
+            recordCommands(frame, commandBuffer, imageIndex, scene);
+            ++m_stats.recordedFrames;
+        }
+
+        std::vector<ASHUtil::SubmitWait> waits;
+        if (!m_headless) {
+            waits.push_back({frame.imageAvailableSemaphore, 0, vk::PipelineStageFlagBits::eColorAttachmentOutput});
         }
+        if (frame.uploadWait.semaphore) {
+            waits.push_back(frame.uploadWait);
+        }
+
+        // null for offscreen targets, nothing waits to present them
+        vk::Semaphore signalSemaphores[] = {m_swapchainFrames[imageIndex].renderFinishedSemaphore};
+        frame.timelineValue = m_timeline->submit(m_graphicsQueue, commandBuffer, waits, signalSemaphores[0]);
+        m_imagesInFlight[imageIndex] = frame.timelineValue;
+        m_latency->track(frame.timelineValue, frameStart);
+
+        // headless frames end at the submit, so their present latency is the time until then
+        vk::Result presentResult = vk::Result::eSuccess;
+        if (!m_headless) {
+            vk::PresentInfoKHR presentInfo{};
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores = signalSemaphores;
+            vk::SwapchainKHR swapChains[] = {m_swapchain};
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = swapChains;
+            presentInfo.pImageIndices = &imageIndex;
+
+            try {
+                presentResult = m_presentQueue.presentKHR(presentInfo);
+            } catch (vk::OutOfDateKHRError) {
+                presentResult = vk::Result::eErrorOutOfDateKHR;
+            } catch (vk::SystemError err) {
+                throw std::runtime_error("Failed to present swap chain image");
+            }
+        }
+
+        // the slot was submitted either way
+        m_currentFrame = (m_currentFrame + 1) % m_maxFramesInFlight;
+
+        m_stats.presentLatencyMs = smooth(m_stats.presentLatencyMs, msBetween(frameStart, Clock::now()));
+        m_stats.gpuLatencyMs = m_latency->getLatencyMs();
 
         if (presentResult == vk::Result::eErrorOutOfDateKHR || presentResult == vk::Result::eSuboptimalKHR) {
             recreateSwapchain();
-            return;
         } else if (presentResult != vk::Result::eSuccess) {
             throw std::runtime_error("Failed to present swap chain image");
         }
 
-        m_currentFrame = (m_currentFrame + 1) % m_maxFramesInFlight;
+        #ifdef BENCHMARK
+        recordTimings(frameStart, msBetween(frameStart, waited), msBetween(waited, Clock::now()), gpuMs);
+        #endif
+    }
 
-        
+    void Engine::limitFrameRate() {
+        Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(m_config.targetFrameTimeMs));
+
+        // sleep alone overshoots by up to a scheduler tick, so the last millisecond is spun away
+        Clock::time_point now = Clock::now();
+        if (m_nextFrameStart - now > std::chrono::milliseconds(1)) {
+            std::this_thread::sleep_for(m_nextFrameStart - now - std::chrono::milliseconds(1));
+        }
+        while (Clock::now() < m_nextFrameStart) {
+            std::this_thread::yield();
+        }
+
+        // a late frame restarts the cadence instead of rushing the next ones to catch up
+        m_nextFrameStart = std::max(m_nextFrameStart, Clock::now()) + period;
+    }
+
+    #ifdef BENCHMARK
+    double Engine::readGpuTime(ASHUtil::InFlightFrame& frame) {
+        if (m_timestampPeriod == 0.0f || !frame.timestampsWritten) {
+            return 0.0;
+        }
+
+        uint64_t timestamps[2];
+        vk::Result result = m_device.getQueryPoolResults(
+            frame.timestampPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64
+        );
+        if (result != vk::Result::eSuccess) {
+            return 0.0;
+        }
+
+        return (timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6;
+    }
+
+    void Engine::recordTimings(Clock::time_point frameStart, double waitMs, double cpuMs, double gpuMs) {
+        if (m_timings.frames > 0) {
+            double frameMs = msBetween(m_lastFrameStart, frameStart);
+            m_timings.frameMs += frameMs;
+            m_timings.waitMs += waitMs;
+            m_timings.cpuMs += cpuMs;
+            m_timings.gpuMs += gpuMs;
+
+            // a frame's time ends when the next one starts, so the hitch is only known one frame later
+            if (m_lastFrameResized) {
+                ++m_timings.resizes;
+                m_timings.resizeFrameMs += frameMs;
+                m_timings.maxResizeFrameMs = std::max(m_timings.maxResizeFrameMs, frameMs);
+            }
+        }
+        m_lastFrameStart = frameStart;
+        m_lastFrameResized = m_resizePending;
+        m_resizePending = false;
+
+        if (++m_timings.frames <= 512) {
+            return;
+        }
+
+        // the first frame of each run only sets the start time
+        double frames = m_timings.frames - 1;
+        double frameMs = m_timings.frameMs / frames;
+        double cpuMs = m_timings.cpuMs / frames;
+        double gpuMs = m_timings.gpuMs / frames;
+
+        // above 1 the CPU and GPU worked at the same time for part of each frame
+        std::cout << "Frames in flight " << m_maxFramesInFlight << (m_config.drawPushConstants ? ", material pushed per draw" : ", material per instance")
+            << ": " << frameMs << " ms/frame, CPU " << cpuMs << " ms, fence wait "
+            << m_timings.waitMs / frames << " ms, GPU " << gpuMs << " ms, overlap " << (cpuMs + gpuMs) / frameMs << std::endl;
+
+        if (m_timings.resizes > 0) {
+            double steadyMs = (m_timings.frameMs - m_timings.resizeFrameMs) / std::max(frames - m_timings.resizes, 1.0);
+            std::cout << "Swapchain recreations: " << m_timings.resizes << ", " << m_timings.resizeFrameMs / m_timings.resizes << " ms/frame, worst "
+                << m_timings.maxResizeFrameMs << " ms, other frames " << steadyMs << " ms/frame, last recreation " << m_stats.swapchainRecreateMs << " ms" << std::endl;
+        }
+
+        // the render thread is the first entry, it only runs jobs while waiting on its own
+        std::vector<ASHUtil::WorkerStats> workers = m_jobs.getStats();
+        std::cout << "Job threads:";
+        for (size_t i = 0; i < workers.size(); ++i) {
+            std::cout << " [" << i << "] " << workers[i].utilization * 100.0 << "% busy, " << workers[i].jobs << " jobs, " << workers[i].stolen << " stolen";
+        }
+        std::cout << std::endl;
+        m_jobs.resetStats();
+
+        m_timings = ASHUtil::FrameTimings();
+
+        // every ring depth runs once with each way of passing the material, the GPU time shows the storage read
+        // per instance against the push per draw, which also gives up multi-draw
+        setDrawPushConstants(!m_config.drawPushConstants);
+        if (!m_config.drawPushConstants) {
+            setFramesInFlight(m_config.framesInFlight % 4 + 1);
+        }
+    }
+
+    void Engine::benchmarkRecording() {
+        constexpr uint32_t drawCount = 4096;
+        constexpr int repeats = 16;
+
+        // nothing recorded here is submitted, the indirect buffer only has to be large enough to record against
+        BufferInput input;
+        input.device = m_device;
+        input.physicalDevice = m_physicalDevice;
+        input.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        input.size = drawCount * sizeof(vk::DrawIndexedIndirectCommand);
+        input.usage = vk::BufferUsageFlagBits::eIndirectBuffer;
+        Buffer scratch = ASHUtil::createBuffer(input);
+
+        ASHUtil::DrawBatch batch;
+        for (uint32_t i = 0; i < drawCount; ++i) {
+            batch.add(3, 0, i, 1, i % 3);
+        }
+
+        ASHUtil::InFlightFrame& frame = m_frames[0];
+        vk::CommandBuffer commandBuffer = frame.commandBuffer;
+
+        vk::RenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.renderPass = m_renderPass;
+        renderPassInfo.framebuffer = m_swapchainFrames[0].framebuffer;
+        renderPassInfo.renderArea.extent = m_swapchainExtent;
+        std::array<vk::ClearValue, 2> clearValues;
+        clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+
+        std::cout << yellow("Command recording benchmark (" + std::to_string(drawCount) + " indirect draws, ms per pass):") << std::endl;
+
+        // powers of two, then every job thread
+        std::vector<uint32_t> threadCounts;
+        uint32_t maxThreads = static_cast<uint32_t>(frame.recordingPools.size());
+        for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(maxThreads);
+
+        for (uint32_t threads : threadCounts) {
+            double totalMs = 0.0;
+
+            for (int r = 0; r < repeats; ++r) {
+                commandBuffer.reset();
+                frame.resetRecordingPools();
+
+                Clock::time_point start = Clock::now();
+                commandBuffer.begin(vk::CommandBufferBeginInfo{});
+                commandBuffer.beginRenderPass(renderPassInfo, threads > 1 ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+                recordDraws(frame, commandBuffer, 0, renderPassInfo, batch, scratch.buffer, 0, threads, false, m_pipelineKey);
+                commandBuffer.endRenderPass();
+                commandBuffer.end();
+                totalMs += msBetween(start, Clock::now());
+            }
+
+            std::cout << "\t" << threads << (threads == 1 ? " thread (inline): " : " threads: ") << totalMs / repeats << std::endl;
+        }
+
+        // recording cost only of the material per draw against per instance, inline with one indirect draw per command
+        // either way, the GPU side of the comparison is in the frame timings
+        bool drawPushConstants = m_config.drawPushConstants;
+        for (bool pushConstants : {false, true}) {
+            m_config.drawPushConstants = pushConstants;
+            double totalMs = 0.0;
+
+            for (int r = 0; r < repeats; ++r) {
+                commandBuffer.reset();
+
+                Clock::time_point start = Clock::now();
+                commandBuffer.begin(vk::CommandBufferBeginInfo{});
+                commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+                recordDraws(frame, commandBuffer, 0, renderPassInfo, batch, scratch.buffer, 0, 1, false, m_pipelineKey);
+                commandBuffer.endRenderPass();
+                commandBuffer.end();
+                totalMs += msBetween(start, Clock::now());
+            }
+
+            std::cout << "\t" << (pushConstants ? "material push constant per draw: " : "material buffer per instance: ") << totalMs / repeats << std::endl;
+        }
+        m_config.drawPushConstants = drawPushConstants;
+
+        commandBuffer.reset();
+        frame.resetRecordingPools();
+
+        m_device.destroyBuffer(scratch.buffer);
+        m_device.freeMemory(scratch.memory);
+    }
+    #endif
+
+    const ASHUtil::FrameStats& Engine::getStats() const {
+        return m_stats;
+    }
+
+    const ASHUtil::DeviceCapabilities& Engine::getCapabilities() const {
+        return m_capabilities;
     }
 
     void Engine::destroySwapchain() {
@@ -436,9 +1579,12 @@ namespace ASH {
             frame.destroy();
         }
 
-        m_device.destroySwapchainKHR(m_swapchain);
+        // headless devices don't enable the swapchain extension
+        if (m_swapchain) {
+            m_device.destroySwapchainKHR(m_swapchain);
+        }
 
-        m_device.destroyDescriptorPool(m_framePool);
+        delete m_depthPyramid;
     }
 
 }
\ No newline at end of file
@@ -7,21 +7,61 @@
 #include "scene.hpp"
 #include "meshwrapper.hpp"
 #include "image.hpp"
+#include "mathkernels.hpp"
+#include "culling.hpp"
+#include "drawbatch.hpp"
+#include "depthpyramid.hpp"
+#include "jobs.hpp"
+#include "occlusion.hpp"
+#include "timeline.hpp"
+#include "transfer.hpp"
+#include "latency.hpp"
+#include "stats.hpp"
+#include "capabilities.hpp"
+#include "pipelinecache.hpp"
+#include "pipelineregistry.hpp"
+#include "config.hpp"
+
+#include <chrono>
 
 namespace ASH {
     class Engine
     {
     public:
-        Engine(int width, int height, GLFWwindow *window);
+        // without a window the engine is headless: no surface or swapchain, frames go to offscreen images it owns
+        Engine(int width, int height, GLFWwindow *window, EngineConfig config = EngineConfig());
         ~Engine();
 
-        void render(Scene *scene);
+        void render(const Scene *scene);
+
+        const ASHUtil::FrameStats& getStats() const;
+
+        // what the device was created with
+        const ASHUtil::DeviceCapabilities& getCapabilities() const;
+
+        // rebuilds the frames in flight ring with count slots, clamped to 1 to 4, waits for the device first
+        void setFramesInFlight(uint32_t count);
+
+        // recreates the swapchain with the closest supported mode
+        void setPresentMode(presentModes mode);
+
+        // switches to the variant with these features, compiling it on the job threads if it is new, frames keep
+        // drawing with the current variant until it is ready
+        void setShaderFeatures(ShaderFeatures features);
+
+        // switches between pushing the material per draw and reading it per instance, waits for the variant's compile
+        // since the other variant reads material data that is no longer written
+        void setDrawPushConstants(bool enabled);
 
     private:
         int m_width;
         int m_height;
 
+        EngineConfig m_config;
+
         GLFWwindow *m_window;
+        bool m_headless;
+        uint32_t m_nextOffscreenImage = 0; // headless targets are rendered to round robin
 
         vk::Instance m_instance;
         vk::DebugUtilsMessengerEXT m_debugMessenger;
@@ -30,49 +70,140 @@ namespace ASH {
 
         vk::PhysicalDevice m_physicalDevice;
         vk::Device m_device;
+        ASHUtil::DeviceCapabilities m_capabilities;
         vk::Queue m_graphicsQueue;
         vk::Queue m_presentQueue;
+        vk::Queue m_transferQueue;
+        ASHUtil::PipelineCache* m_pipelineCache; // shared by every pipeline, persisted between runs
+        ASHUtil::Timeline* m_timeline; // signaled by every submission on the graphics queue
+        ASHUtil::TransferQueue* m_transfer; // uploads, with their own timeline
+        ASHUtil::FrameLatencyTracker* m_latency;
+        std::chrono::steady_clock::time_point m_nextFrameStart; // FIFO_LIMITED pacing
         vk::SwapchainKHR m_swapchain;
         std::vector<ASHUtil::SwapChainFrame> m_swapchainFrames;
+        std::vector<uint64_t> m_imagesInFlight; // timeline value of the last frame rendered to each swapchain image
         vk::Format m_swapchainFormat;
         vk::Extent2D m_swapchainExtent;
 
-        vk::Pipeline m_pipeline;
+        ASHUtil::PipelineRegistry* m_pipelines;
+        uint64_t m_pipelineKey, m_cullPipelineKey, m_depthReducePipelineKey;
+        uint64_t m_depthPipelineKey = 0; // depth pre-pass, 0 without one
         vk::PipelineLayout m_pipelineLayout;
         vk::RenderPass m_renderPass;
+        vk::RenderPass m_earlyRenderPass, m_lateRenderPass; // occlusion culling splits the frame around the depth pyramid build
 
         vk::CommandPool m_commandPool;
         vk::CommandBuffer m_primaryCommandBuffer;
 
+        std::vector<ASHUtil::InFlightFrame> m_frames;
         int m_maxFramesInFlight, m_currentFrame;
 
         vk::DescriptorSetLayout m_frameSetLayout;
+        vk::DescriptorUpdateTemplate m_frameUpdateTemplate, m_cullUpdateTemplate;
         vk::DescriptorPool m_framePool;
         vk::DescriptorSetLayout m_meshSetLayout;
         vk::DescriptorPool m_meshPool;
+        vk::DescriptorSet m_materialSet;
+
+        vk::PipelineLayout m_cullPipelineLayout;
+        vk::DescriptorSetLayout m_cullSetLayout;
+        vk::DescriptorPool m_cullPool;
+
+        vk::PipelineLayout m_depthReducePipelineLayout;
+        vk::DescriptorSetLayout m_depthReduceSetLayout;
+        ASHImage::DepthPyramid* m_depthPyramid;
+        bool m_historyValid; // the pyramid holds the depth of the previous frame
+        glm::mat4 m_lastViewProjection;
 
         MeshWrapper* m_meshes;
         std::unordered_map<meshTypes, ASHImage::Texture*> m_materials;
 
+        std::vector<ASHMath::Transform> m_transforms;
+        std::vector<glm::mat4> m_instanceMatrices;
+        ASHUtil::FrustumCuller m_culler;
+        ASHUtil::DrawBatch m_drawBatch;
+        ASHUtil::DrawBatch m_lateDrawBatch;
+        bool m_multiDrawIndirect;
+
+        ASHUtil::JobSystem m_jobs; // asset import, transforms, culling and command recording
+        ASHUtil::OcclusionRasterizer m_occlusion;
+        std::unordered_map<meshTypes, bool> m_occluders; // mesh types rasterized by the software occlusion pass
+        #ifdef BENCHMARK
+        ASHUtil::OcclusionMetrics m_occlusionTotals;
+        uint32_t m_occlusionFrames = 0;
+        #endif
+
+        ASHUtil::FrameStats m_stats;
+        #ifdef BENCHMARK
+        ASHUtil::FrameTimings m_timings;
+        std::chrono::steady_clock::time_point m_lastFrameStart;
+        bool m_resizePending = false;   // set by recreateSwapchain, the current frame recreated it
+        bool m_lastFrameResized = false;
+        float m_timestampPeriod; // nanoseconds per tick, 0 if the graphics queue can't write timestamps
+        #endif
+
         void createInstance();
 
         void createDevice();
-        void createSwapchain();
+        void createSwapchain(vk::SwapchainKHR oldSwapchain = nullptr);
+        void createOffscreenTargets();
+        vk::PresentModeKHR getPresentMode() const;
+        // without draining the GPU, what frames in flight still use is destroyed once the timeline passes them
         void recreateSwapchain();
         void destroySwapchain();
 
         void createDescriptorSetLayouts();
         void createPipeline();
+        // requests the main pipeline variant with these features and returns its key
+        uint64_t requestMainPipeline(ShaderFeatures features, uint64_t placeholderKey);
+        // compile time and placeholder use of every variant so far
+        void printPipelineStats() const;
 
         void finishSetup();
         void createFramebuffers();
         void createFrameResources();
+        void createFramesInFlight();
+        void destroyFramesInFlight();
+        // cacheCommandBuffers only, tied to both the ring and the swapchain images
+        void createCommandCache();
+        void destroyCommandCache();
+        // hash of everything recordCommands bakes in, never 0
+        uint64_t getRecordingKey(const ASHUtil::InFlightFrame& frame) const;
 
         void createAssets();
         void prepScene(vk::CommandBuffer commandBuffer);
-        void prepFrame(uint32_t imageIndex, Scene *scene);
-
-        void recordCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene *scene);
-        void renderObjects(vk::CommandBuffer commandBuffer, meshTypes type, uint32_t& startInstance, uint32_t instanceCount);
+        void prepFrame(ASHUtil::InFlightFrame& frame, const Scene *scene);
+        void cullOnCpu(ASHUtil::InFlightFrame& frame, const Scene *scene);
+        void prepGpuCulling(ASHUtil::InFlightFrame& frame, const Scene *scene);
+
+        // sleeps until the next frame is due, FIFO_LIMITED only
+        void limitFrameRate();
+
+        void recordCommands(ASHUtil::InFlightFrame& frame, vk::CommandBuffer commandBuffer, uint32_t imageIndex, const Scene *scene);
+        void recordCulling(ASHUtil::InFlightFrame& frame, vk::CommandBuffer commandBuffer, ASHUtil::cullPhases phase);
+        void recordPass(ASHUtil::InFlightFrame& frame, vk::CommandBuffer commandBuffer, uint32_t imageIndex, vk::RenderPass renderPass, const ASHUtil::DrawBatch& batch, vk::DeviceSize indirectOffset, uint32_t pass);
+        // how many secondary command buffers a pass with drawCount commands is split into, 1 records inline
+        // the scene's passes stay well under drawsPerRecordingThread, so the split path is exercised by benchmarkRecording,
+        // splitting a handful of draws would only add the cost of the secondary buffers
+        uint32_t getRecordingThreads(uint32_t drawCount, bool multiDrawIndirect) const;
+        // records the batch into the primary command buffer, or splits it over the slot's secondary buffers for
+        // the pass and executes them, renderPassInfo has to have been begun with the matching subpass contents
+        void recordDraws(ASHUtil::InFlightFrame& frame, vk::CommandBuffer commandBuffer, uint32_t pass, const vk::RenderPassBeginInfo& renderPassInfo, const ASHUtil::DrawBatch& batch, vk::Buffer indirectBuffer, vk::DeviceSize indirectOffset, uint32_t threads, bool multiDrawIndirect, uint64_t pipelineKey);
+        void recordDrawRange(vk::CommandBuffer commandBuffer, ASHUtil::InFlightFrame& frame, const ASHUtil::DrawBatch& batch, vk::Buffer indirectBuffer, vk::DeviceSize indirectOffset, uint32_t first, uint32_t count, bool multiDrawIndirect, uint64_t pipelineKey);
+        void recordDepthPyramid(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+        vk::ImageMemoryBarrier createDepthBarrier(uint32_t imageIndex, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+        // fragment shader invocations of the slot's last submission, which has to have finished
+        void readFragmentInvocations(ASHUtil::InFlightFrame& frame);
+
+        #ifdef BENCHMARK
+        // GPU time of the last submission of the slot, which has to have finished
+        double readGpuTime(ASHUtil::InFlightFrame& frame);
+        // sums the timings of each frame, every 512 frames reports them and moves on to the other material path,
+        // then to the next ring depth
+        // frames that recreated the swapchain are also reported on their own, so a resize hitch shows up
+        void recordTimings(std::chrono::steady_clock::time_point frameStart, double waitMs, double cpuMs, double gpuMs);
+        // time to record a pass of single indirect draws into 1 to all job threads' secondary command buffers
+        void benchmarkRecording();
+        #endif
     };
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #include "frame.hpp"
 #include "memory.hpp"
 #include "image.hpp"
+#include "culling.hpp"
 
 
-void ASHUtil::SwapChainFrame::createDescriptorResources() {
+void ASHUtil::InFlightFrame::createDescriptorResources() {
     BufferInput input;
     input.device = device;
     input.physicalDevice = physicalDevice;
@@ -15,39 +16,151 @@ void ASHUtil::SwapChainFrame::createDescriptorResources() {
 
     cameraDataWritePtr = device.mapMemory(cameraDataBuffer.memory, 0, sizeof(UBO));
 
-    int maxModelMatrices = 1024;
-    input.size = maxModelMatrices * sizeof(glm::mat4); // 1024 model matrices limit
+    input.size = maxDraws * sizeof(CullDraw);
     input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    cullDrawBuffer = createBuffer(input);
+    cullDrawWritePtr = device.mapMemory(cullDrawBuffer.memory, 0, input.size);
+
+    input.size = maxDrawCommands * sizeof(vk::DrawIndexedIndirectCommand);
+    input.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+    indirectBuffer = createBuffer(input);
+    indirectWritePtr = device.mapMemory(indirectBuffer.memory, 0, input.size);
+
+    input.size = sizeof(uint32_t);
+    input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    cullStatsBuffer = createBuffer(input);
+    cullStatsWritePtr = device.mapMemory(cullStatsBuffer.memory, 0, input.size);
+    memset(cullStatsWritePtr, 0, input.size);
+
+    createInstanceBuffers(initialInstanceCapacity);
+}
+
+void ASHUtil::InFlightFrame::createInstanceBuffers(uint32_t capacity) {
+    instanceCapacity = capacity;
+
+    // the early and late occlusion phases compact into separate ranges
+    uint32_t visibleCapacity = 2 * capacity;
+
+    BufferInput input;
+    input.device = device;
+    input.physicalDevice = physicalDevice;
+    input.properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+
+    input.size = visibleCapacity * sizeof(glm::mat4);
     modelMatrixBuffer = createBuffer(input);
+    modelMatrixWritePtr = device.mapMemory(modelMatrixBuffer.memory, 0, input.size);
+    modelMatrices.assign(visibleCapacity, glm::mat4(1.0f));
+
+    input.size = visibleCapacity * sizeof(uint32_t);
+    materialIndexBuffer = createBuffer(input);
+    materialIndexWritePtr = device.mapMemory(materialIndexBuffer.memory, 0, input.size);
+    materialIndices.assign(visibleCapacity, 0);
+
+    input.size = capacity * sizeof(CullInstance);
+    cullInstanceBuffer = createBuffer(input);
+    cullInstanceWritePtr = device.mapMemory(cullInstanceBuffer.memory, 0, input.size);
+
+    // only ever touched by the culling pass
+    input.size = capacity * sizeof(uint32_t);
+    input.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    cullPendingBuffer = createBuffer(input);
+
+    frameDescriptors.ubo = vk::DescriptorBufferInfo(cameraDataBuffer.buffer, 0, sizeof(UBO));
+    frameDescriptors.modelMatrices = vk::DescriptorBufferInfo(modelMatrixBuffer.buffer, 0, VK_WHOLE_SIZE);
+    frameDescriptors.materialIndices = vk::DescriptorBufferInfo(materialIndexBuffer.buffer, 0, VK_WHOLE_SIZE);
+
+    cullDescriptors.buffers[0] = vk::DescriptorBufferInfo(cullInstanceBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cullDescriptors.buffers[1] = vk::DescriptorBufferInfo(cullDrawBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cullDescriptors.buffers[2] = vk::DescriptorBufferInfo(modelMatrixBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cullDescriptors.buffers[3] = vk::DescriptorBufferInfo(indirectBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cullDescriptors.buffers[4] = vk::DescriptorBufferInfo(materialIndexBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cullDescriptors.buffers[5] = vk::DescriptorBufferInfo(cullPendingBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cullDescriptors.buffers[6] = vk::DescriptorBufferInfo(cullStatsBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cullDescriptors.ubo = frameDescriptors.ubo;
+
+    descriptorsDirty = true;
+    cullDescriptorsDirty = true;
+}
+
+void ASHUtil::InFlightFrame::destroyInstanceBuffers() {
+    device.unmapMemory(modelMatrixBuffer.memory);
+    device.unmapMemory(materialIndexBuffer.memory);
+    device.unmapMemory(cullInstanceBuffer.memory);
 
-    modelMatrixWritePtr = device.mapMemory(modelMatrixBuffer.memory, 0, maxModelMatrices * sizeof(glm::mat4));
+    device.freeMemory(modelMatrixBuffer.memory);
+    device.freeMemory(materialIndexBuffer.memory);
+    device.freeMemory(cullInstanceBuffer.memory);
+    device.freeMemory(cullPendingBuffer.memory);
 
-    modelMatrices.reserve(maxModelMatrices);
+    device.destroyBuffer(modelMatrixBuffer.buffer);
+    device.destroyBuffer(materialIndexBuffer.buffer);
+    device.destroyBuffer(cullInstanceBuffer.buffer);
+    device.destroyBuffer(cullPendingBuffer.buffer);
+}
 
-    for (int i = 0; i < maxModelMatrices; ++i) {
-        modelMatrices.push_back(glm::mat4(1.0f));
+bool ASHUtil::InFlightFrame::reserveInstances(uint32_t count) {
+    if (count <= instanceCapacity) {
+        return false;
     }
 
+    // only called once the slot's last submission finished, nothing else reads these buffers
+    destroyInstanceBuffers();
+    createInstanceBuffers(std::max(count, 2 * instanceCapacity));
+    return true;
+}
+
+void ASHUtil::InFlightFrame::setDepthPyramid(vk::DescriptorImageInfo depthPyramid) {
+    cullDescriptors.depthPyramid = depthPyramid;
+    cullDescriptorsDirty = true;
+}
+
+void ASHUtil::InFlightFrame::updateDescriptorSets(vk::DescriptorUpdateTemplate frameTemplate, vk::DescriptorUpdateTemplate cullTemplate) {
+    if (!descriptorsDirty && !cullDescriptorsDirty) {
+        return;
+    }
 
-    uboDescriptor.buffer = cameraDataBuffer.buffer;
-    uboDescriptor.offset = 0;
-    uboDescriptor.range = sizeof(UBO);
+    if (descriptorsDirty) {
+        device.updateDescriptorSetWithTemplate(descriptorSet, frameTemplate, &frameDescriptors);
+    }
+    if (cullDescriptorsDirty) {
+        device.updateDescriptorSetWithTemplate(cullDescriptorSet, cullTemplate, &cullDescriptors);
+    }
+    descriptorsDirty = false;
+    cullDescriptorsDirty = false;
 
-    modelMatrixDescriptor.buffer = modelMatrixBuffer.buffer;
-    modelMatrixDescriptor.offset = 0;
-    modelMatrixDescriptor.range = maxModelMatrices * sizeof(glm::mat4);
+    // updating a set invalidates every command buffer it is bound in
+    std::fill(cachedKeys.begin(), cachedKeys.end(), 0);
+}
 
+void ASHUtil::SwapChainFrame::createOffscreenImage(vk::Format format) {
+    ASHImage::ImageInput input;
+    input.device = device;
+    input.physicalDevice = physicalDevice;
+    input.tiling = vk::ImageTiling::eOptimal;
+    input.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+    input.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    input.width = width;
+    input.height = height;
+    input.format = format;
 
+    image = ASHImage::createImage(input);
+    imageMemory = ASHImage::createImageMemory(input, image);
+    imageView = ASHImage::createImageView(device, image, format, vk::ImageAspectFlagBits::eColor);
 }
 
 void ASHUtil::SwapChainFrame::createDepthResources() {
-    depthFormat = ASHImage::getSupportedFormat(physicalDevice, {vk::Format::eD32Sfloat, vk::Format::eD24UnormS8Uint}, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+    // sampled by the depth pyramid build
+    depthFormat = ASHImage::getSupportedFormat(
+        physicalDevice, {vk::Format::eD32Sfloat, vk::Format::eD24UnormS8Uint}, vk::ImageTiling::eOptimal,
+        vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage
+    );
 
     ASHImage::ImageInput input;
     input.device = device;
     input.physicalDevice = physicalDevice;
     input.tiling = vk::ImageTiling::eOptimal;
-    input.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+    input.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
     input.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;    
     input.width = width;
     input.height = height;
@@ -58,50 +171,60 @@ void ASHUtil::SwapChainFrame::createDepthResources() {
     depthBufferView = ASHImage::createImageView(device, depthBuffer, depthFormat, vk::ImageAspectFlagBits::eDepth);
 }
 
-void ASHUtil::SwapChainFrame::writeDescriptorSet() {
-    vk::WriteDescriptorSet writeInfo;
-    writeInfo.dstSet = descriptorSet;
-    writeInfo.dstBinding = 0;
-    writeInfo.dstArrayElement = 0;
-    writeInfo.descriptorCount = 1;
-    writeInfo.descriptorType = vk::DescriptorType::eUniformBuffer;
-    writeInfo.pBufferInfo = &uboDescriptor;
-
-    device.updateDescriptorSets(writeInfo, nullptr);
-
-    vk::WriteDescriptorSet modelMatrixWriteInfo;
-    modelMatrixWriteInfo.dstSet = descriptorSet;
-    modelMatrixWriteInfo.dstBinding = 1;
-    modelMatrixWriteInfo.dstArrayElement = 0;
-    modelMatrixWriteInfo.descriptorCount = 1;
-    modelMatrixWriteInfo.descriptorType = vk::DescriptorType::eStorageBuffer;
-    modelMatrixWriteInfo.pBufferInfo = &modelMatrixDescriptor;
-
-    device.updateDescriptorSets(modelMatrixWriteInfo, nullptr);
-}
-
 void ASHUtil::SwapChainFrame::destroy() {
-    device.unmapMemory(cameraDataBuffer.memory);
-    device.unmapMemory(modelMatrixBuffer.memory);
-
-    device.freeMemory(cameraDataBuffer.memory);
-    device.freeMemory(modelMatrixBuffer.memory);
-
-    device.destroyBuffer(cameraDataBuffer.buffer);
-    device.destroyBuffer(modelMatrixBuffer.buffer);
-
     device.destroyImage(depthBuffer);
 
     device.freeMemory(depthBufferMemory);
 
     device.destroyImageView(depthBufferView);
     device.destroyImageView(imageView);
+    if (imageMemory) {
+        device.destroyImage(image);
+        device.freeMemory(imageMemory);
+    }
 
     device.destroyFramebuffer(framebuffer);
 
-    device.destroyFence(inFlightFence);
-
-    device.destroySemaphore(imageAvailableSemaphore);
     device.destroySemaphore(renderFinishedSemaphore);
 }
 
+void ASHUtil::InFlightFrame::resetRecordingPools() {
+    for (vk::CommandPool pool : recordingPools) {
+        device.resetCommandPool(pool);
+    }
+}
+
+void ASHUtil::InFlightFrame::destroy() {
+    // frees the secondary command buffers with them
+    for (vk::CommandPool pool : recordingPools) {
+        device.destroyCommandPool(pool);
+    }
+    recordingPools.clear();
+    secondaryBuffers.clear();
+
+    destroyInstanceBuffers();
+
+    device.unmapMemory(cameraDataBuffer.memory);
+    device.unmapMemory(cullDrawBuffer.memory);
+    device.unmapMemory(indirectBuffer.memory);
+    device.unmapMemory(cullStatsBuffer.memory);
+
+    device.freeMemory(cameraDataBuffer.memory);
+    device.freeMemory(cullDrawBuffer.memory);
+    device.freeMemory(indirectBuffer.memory);
+    device.freeMemory(cullStatsBuffer.memory);
+
+    device.destroyBuffer(cameraDataBuffer.buffer);
+    device.destroyBuffer(cullDrawBuffer.buffer);
+    device.destroyBuffer(indirectBuffer.buffer);
+    device.destroyBuffer(cullStatsBuffer.buffer);
+
+    if (statisticsPool) {
+        device.destroyQueryPool(statisticsPool);
+    }
+    #ifdef BENCHMARK
+    device.destroyQueryPool(timestampPool);
+    #endif
+
+    device.destroySemaphore(imageAvailableSemaphore);
+}
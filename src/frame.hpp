@@ -2,20 +2,47 @@
 
 #include "libs.hpp"
 #include "memory.hpp"
+#include "timeline.hpp"
 
 namespace ASHUtil {
+    constexpr uint32_t initialInstanceCapacity = 1024; // the instance buffers grow past it when a scene needs more
+    constexpr uint32_t maxDraws = 64;
+
+    // the early and late occlusion phases compact into separate ranges with separate commands
+    constexpr uint32_t maxDrawCommands = 2 * maxDraws;
+
+    // render passes per frame that record into secondary command buffers, the early and late occlusion passes
+    // and the depth pre-pass of each
+    constexpr uint32_t maxRecordedPasses = 4;
+
     struct UBO {
         glm::mat4 view;
         glm::mat4 projection;
         glm::mat4 viewProjection;
+        glm::mat4 previousViewProjection; // of the frame the depth pyramid was built from
+    };
+
+    // laid out the way the descriptor update templates read them, one entry per binding
+    struct FrameDescriptors {
+        vk::DescriptorBufferInfo ubo;
+        vk::DescriptorBufferInfo modelMatrices;
+        vk::DescriptorBufferInfo materialIndices;
+    };
+
+    struct CullDescriptors {
+        vk::DescriptorBufferInfo buffers[7]; // instances, draws, visible instances, indirect commands, visible materials, pending, stats
+        vk::DescriptorBufferInfo ubo;
+        vk::DescriptorImageInfo depthPyramid;
     };
 
+    // per swapchain image, only touched by the GPU while that image is in flight
     class SwapChainFrame { // TODO: add m_ prefix to member variables
         public:
             vk::Device device;
             vk::PhysicalDevice physicalDevice;
 
             vk::Image image;
+            vk::DeviceMemory imageMemory; // only set for offscreen targets, swapchain images belong to the swapchain
             vk::ImageView imageView;
             vk::Framebuffer framebuffer;
             vk::Image depthBuffer;
@@ -24,10 +51,36 @@ namespace ASHUtil {
             vk::Format depthFormat;
             int width, height;
 
+            // presentation holds on to it until the image is acquired again, which is tracked per image, not per frame
+            vk::Semaphore renderFinishedSemaphore;
+
+            // headless stand-in for a swapchain image, in a layout it can be copied out of
+            void createOffscreenImage(vk::Format format);
+            void createDepthResources();
+            void destroy();
+    };
+
+    // one slot of the frames in flight ring, everything the CPU writes while recording a frame
+    class InFlightFrame {
+        public:
+            vk::Device device;
+            vk::PhysicalDevice physicalDevice;
+
             vk::CommandBuffer commandBuffer;
 
-            vk::Semaphore imageAvailableSemaphore, renderFinishedSemaphore;
-            vk::Fence inFlightFence;
+            // one pool per recording thread since a pool can't be used from two threads at once, each holds a
+            // secondary command buffer per pass and is reset as a whole once the slot's submission has finished
+            std::vector<vk::CommandPool> recordingPools;
+            std::vector<std::array<vk::CommandBuffer, maxRecordedPasses>> secondaryBuffers;
+
+            // only with cacheCommandBuffers, one per swapchain image since the framebuffer is baked in, replayed
+            // while the key of what they were recorded from still matches, a key of 0 forces recording
+            std::vector<vk::CommandBuffer> cachedCommandBuffers;
+            std::vector<uint64_t> cachedKeys;
+
+            vk::Semaphore imageAvailableSemaphore;
+            uint64_t timelineValue = 0; // the slot's buffers are free once the engine's timeline reaches it
+            SubmitWait uploadWait; // uploads whose ownership this frame's commands acquire, if any
 
             UBO cameraData;
             Buffer cameraDataBuffer;
@@ -37,13 +90,51 @@ namespace ASHUtil {
             Buffer modelMatrixBuffer;
             void* modelMatrixWritePtr;
 
-            vk::DescriptorBufferInfo uboDescriptor;
-            vk::DescriptorBufferInfo modelMatrixDescriptor;
+            std::vector<uint32_t> materialIndices;
+            Buffer materialIndexBuffer;
+            void* materialIndexWritePtr;
+
+            // GPU culling inputs and the indirect commands it fills
+            Buffer cullInstanceBuffer;
+            void* cullInstanceWritePtr;
+            Buffer cullDrawBuffer;
+            void* cullDrawWritePtr;
+            Buffer indirectBuffer;
+            void* indirectWritePtr;
+            Buffer cullPendingBuffer;
+            Buffer cullStatsBuffer;
+            void* cullStatsWritePtr;
+            uint32_t cullInstanceCount = 0;
+            uint32_t drawCount = 0;
+            uint32_t instanceCapacity = 0; // of the instance sized buffers, visible ranges hold twice as many
+
+            // the sets are only written when what they point at changed, before the slot records again
+            FrameDescriptors frameDescriptors;
+            CullDescriptors cullDescriptors;
+            bool descriptorsDirty = true;
+            bool cullDescriptorsDirty = true;
             vk::DescriptorSet descriptorSet;
+            vk::DescriptorSet cullDescriptorSet;
+
+            vk::QueryPool statisticsPool; // fragment shader invocations over the command buffer, null without pipeline statistics
+            bool statisticsWritten = false;
+
+            #ifdef BENCHMARK
+            vk::QueryPool timestampPool; // start and end of the command buffer
+            bool timestampsWritten = false;
+            #endif
 
             void createDescriptorResources();
-            void createDepthResources();
-            void writeDescriptorSet();
+            // grows the instance buffers to hold count instances, true when they were reallocated
+            bool reserveInstances(uint32_t count);
+            void setDepthPyramid(vk::DescriptorImageInfo depthPyramid);
+            // writes the sets marked dirty and drops the cached command buffers they were bound in
+            void updateDescriptorSets(vk::DescriptorUpdateTemplate frameTemplate, vk::DescriptorUpdateTemplate cullTemplate);
+            void resetRecordingPools();
             void destroy();
+
+        private:
+            void createInstanceBuffers(uint32_t capacity);
+            void destroyInstanceBuffers();
     };
 }
\ No newline at end of file
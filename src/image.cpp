@@ -4,19 +4,22 @@
 #include "stb_image.h"
 
 #include "memory.hpp"
-#include "descriptors.hpp"
-#include "onetimecommands.hpp"
 
 ASHImage::Texture::Texture(TextureInput input) {
     m_device = input.device;
     m_physicalDevice = input.physicalDevice;
     m_path = input.path;
-    m_commandBuffer = input.commandBuffer;
-    m_queue = input.queue;
-    m_layout = input.layout;
-    m_descriptorPool = input.pool;
-
-    load();
+    m_transfer = input.transfer;
+
+    if (input.data) {
+        m_width = input.data->width;
+        m_height = input.data->height;
+        m_channels = input.data->channels;
+        m_pixels = input.data->pixels;
+        input.data->pixels = nullptr;
+    } else {
+        load();
+    }
 
     ImageInput imageInput;
     imageInput.device = m_device;
@@ -38,8 +41,6 @@ ASHImage::Texture::Texture(TextureInput input) {
     createView();
 
     createSampler();
-
-    createDescriptorSet();
 }
 
 ASHImage::Texture::~Texture() {
@@ -49,20 +50,34 @@ ASHImage::Texture::~Texture() {
     m_device.freeMemory(m_imageMemory);
 }
 
-void ASHImage::Texture::use(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout) {
-    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 1, m_descriptorSet, nullptr);
+vk::DescriptorImageInfo ASHImage::Texture::getDescriptorInfo() const {
+    vk::DescriptorImageInfo imageInfo;
+    imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    imageInfo.imageView = m_imageView;
+    imageInfo.sampler = m_sampler;
+    return imageInfo;
 }
 
 void ASHImage::Texture::load() {
-    stbi_set_flip_vertically_on_load(true);
+    TextureData data = decodeTexture(m_path);
+    m_width = data.width;
+    m_height = data.height;
+    m_channels = data.channels;
+    m_pixels = data.pixels;
+}
 
-    stbi_uc* pixels = stbi_load(m_path, &m_width, &m_height, &m_channels, STBI_rgb_alpha);
+ASHImage::TextureData ASHImage::decodeTexture(const char* path) {
+    // the per thread flag, decodes may run on several job threads at once
+    stbi_set_flip_vertically_on_load_thread(true);
 
-    if (!pixels) {
-        throw std::runtime_error("Failed to load texture " + std::string(m_path));
+    TextureData data;
+    data.pixels = stbi_load(path, &data.width, &data.height, &data.channels, STBI_rgb_alpha);
+
+    if (!data.pixels) {
+        throw std::runtime_error("Failed to load texture " + std::string(path));
     }
 
-    m_pixels = pixels;
+    return data;
 }
 
 void ASHImage::Texture::populate() {
@@ -79,29 +94,35 @@ void ASHImage::Texture::populate() {
     memcpy(memoryLoc, m_pixels, input.size);
     m_device.unmapMemory(stagingBuffer.memory);
 
+    // one job on the transfer queue, the final layout is set by the ownership transfer to the graphics queue
+    vk::CommandBuffer commandBuffer = m_transfer->begin();
+
     ImageLayoutTransition transition;
-    transition.commandBuffer = m_commandBuffer;
-    transition.queue = m_queue;
+    transition.commandBuffer = commandBuffer;
     transition.image = m_image;
     transition.oldLayout = vk::ImageLayout::eUndefined;
     transition.newLayout = vk::ImageLayout::eTransferDstOptimal;
     transitionImageLayout(transition);
 
     BufferCopy copy;
-    copy.commandBuffer = m_commandBuffer;
-    copy.queue = m_queue;
+    copy.commandBuffer = commandBuffer;
     copy.srcBuffer = stagingBuffer.buffer;
     copy.dstImage = m_image;
     copy.width = m_width;
     copy.height = m_height;
     copyBufferToImage(copy);
 
-    transition.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-    transition.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    transitionImageLayout(transition);
+    m_transfer->releaseImage(
+        m_image, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead
+    );
+    uint64_t uploaded = m_transfer->submit();
 
-    m_device.freeMemory(stagingBuffer.memory);
-    m_device.destroyBuffer(stagingBuffer.buffer);
+    vk::Device device = m_device;
+    m_transfer->getTimeline().destroyAfter(uploaded, [device, stagingBuffer]() {
+        device.freeMemory(stagingBuffer.memory);
+        device.destroyBuffer(stagingBuffer.buffer);
+    });
 }
 
 void ASHImage::Texture::createView() {
@@ -134,32 +155,12 @@ void ASHImage::Texture::createSampler() {
     }
 }
 
-void ASHImage::Texture::createDescriptorSet() {
-    m_descriptorSet = ASHInit::allocateDescriptorSet(m_device, m_descriptorPool, m_layout);
-
-    vk::DescriptorImageInfo imageInfo;
-    imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    imageInfo.imageView = m_imageView;
-    imageInfo.sampler = m_sampler;
-
-    vk::WriteDescriptorSet descriptorWrite;
-    descriptorWrite.dstSet = m_descriptorSet;
-    descriptorWrite.dstBinding = 0;
-    descriptorWrite.dstArrayElement = 0;
-    descriptorWrite.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-    descriptorWrite.descriptorCount = 1;
-    descriptorWrite.pImageInfo = &imageInfo;
-
-    m_device.updateDescriptorSets(descriptorWrite, nullptr);
-
-}
-
 vk::Image ASHImage::createImage(ImageInput input) {
     vk::ImageCreateInfo imageInfo;
     imageInfo.flags = vk::ImageCreateFlags();
     imageInfo.imageType = vk::ImageType::e2D;
     imageInfo.extent = vk::Extent3D(input.width, input.height, 1);
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = input.mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = input.format;
     imageInfo.tiling = input.tiling;
@@ -196,8 +197,6 @@ vk::DeviceMemory ASHImage::createImageMemory(ImageInput input, vk::Image image)
 }
 
 void ASHImage::transitionImageLayout(ImageLayoutTransition input) {
-    ASHUtil::startJob(input.commandBuffer);
-
     vk::ImageSubresourceRange range;
     range.aspectMask = vk::ImageAspectFlagBits::eColor;
     range.baseMipLevel = 0;
@@ -236,13 +235,9 @@ void ASHImage::transitionImageLayout(ImageLayoutTransition input) {
         vk::DependencyFlags(),
         nullptr, nullptr, barrier
     );
-
-    ASHUtil::endJob(input.commandBuffer, input.queue);
 }
 
 void ASHImage::copyBufferToImage(BufferCopy input) {
-    ASHUtil::startJob(input.commandBuffer);
-
     vk::BufferImageCopy copy;
     copy.bufferOffset = 0;
     copy.bufferRowLength = 0;
@@ -259,11 +254,9 @@ void ASHImage::copyBufferToImage(BufferCopy input) {
     copy.imageExtent = vk::Extent3D(input.width, input.height, 1);
 
     input.commandBuffer.copyBufferToImage(input.srcBuffer, input.dstImage, vk::ImageLayout::eTransferDstOptimal, copy);
-
-    ASHUtil::endJob(input.commandBuffer, input.queue);
 }
 
-vk::ImageView ASHImage::createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags) {
+vk::ImageView ASHImage::createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t baseMipLevel, uint32_t levelCount) {
     vk::ImageViewCreateInfo createInfo{};
     createInfo.image = image;
     createInfo.viewType = vk::ImageViewType::e2D;
@@ -272,8 +265,8 @@ vk::ImageView ASHImage::createImageView(vk::Device device, vk::Image image, vk::
     createInfo.components.b = vk::ComponentSwizzle::eIdentity;
     createInfo.components.a = vk::ComponentSwizzle::eIdentity;
     createInfo.subresourceRange.aspectMask = aspectFlags;
-    createInfo.subresourceRange.baseMipLevel = 0;
-    createInfo.subresourceRange.levelCount = 1;
+    createInfo.subresourceRange.baseMipLevel = baseMipLevel;
+    createInfo.subresourceRange.levelCount = levelCount;
     createInfo.subresourceRange.baseArrayLayer = 0;
     createInfo.subresourceRange.layerCount = 1;
     createInfo.format = format;
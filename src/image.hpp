@@ -1,19 +1,24 @@
 #pragma once
 
 #include "libs.hpp"
+#include "transfer.hpp"
 
 #include "stb_image.h"
 
 namespace ASHImage {
 
+    // RGBA8 pixels, decoding touches nothing but the file so it can run on any thread
+    struct TextureData {
+        int width = 0, height = 0, channels = 0;
+        stbi_uc* pixels = nullptr;
+    };
+
     struct TextureInput {
         vk::Device device;
         vk::PhysicalDevice physicalDevice;
         const char* path;
-        vk::CommandBuffer commandBuffer;
-        vk::Queue queue;
-        vk::DescriptorSetLayout layout;
-        vk::DescriptorPool pool;
+        ASHUtil::TransferQueue* transfer;
+        TextureData* data = nullptr; // already decoded, the texture takes over the pixels, otherwise path is loaded here
     };
 
     struct ImageInput {
@@ -24,18 +29,17 @@ namespace ASHImage {
         vk::ImageUsageFlags usage;
         vk::MemoryPropertyFlags properties;
         vk::Format format;
+        uint32_t mipLevels = 1;
     };
 
     struct ImageLayoutTransition {
         vk::CommandBuffer commandBuffer;
-        vk::Queue queue;
         vk::Image image;
         vk::ImageLayout oldLayout, newLayout;
     };
 
     struct BufferCopy {
         vk::CommandBuffer commandBuffer;
-        vk::Queue queue;
         vk::Buffer srcBuffer;
         vk::Image dstImage;
         int width, height;
@@ -46,7 +50,8 @@ namespace ASHImage {
             Texture(TextureInput input);
             ~Texture();
 
-            void use(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout);
+            // for writing into the material array that the fragment shader indexes
+            vk::DescriptorImageInfo getDescriptorInfo() const;
 
 
         private:
@@ -61,12 +66,7 @@ namespace ASHImage {
             vk::ImageView m_imageView;
             vk::Sampler m_sampler;
 
-            vk::DescriptorSetLayout m_layout;
-            vk::DescriptorSet m_descriptorSet;
-            vk::DescriptorPool m_descriptorPool;
-
-            vk::CommandBuffer m_commandBuffer;
-            vk::Queue m_queue;
+            ASHUtil::TransferQueue* m_transfer;
 
             void load(); 
 
@@ -75,19 +75,20 @@ namespace ASHImage {
             void createView(); 
 
             void createSampler(); 
-
-            void createDescriptorSet(); 
     };
 
+    TextureData decodeTexture(const char* path);
+
     vk::Image createImage(ImageInput input);
 
     vk::DeviceMemory createImageMemory(ImageInput input, vk::Image image);
 
+    // both record into input.commandBuffer, submitting is up to the caller
     void transitionImageLayout(ImageLayoutTransition input);
 
     void copyBufferToImage(BufferCopy input);
 
-    vk::ImageView createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags);
+    vk::ImageView createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
 
     vk::Format getSupportedFormat(vk::PhysicalDevice physicalDevice, const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features);
 }
\ No newline at end of file
@@ -68,13 +68,14 @@ namespace ASHInit
         return true;
     }
 
-    vk::Instance createInstance(const std::string &name)
+    // headless instances skip the window system extensions GLFW asks for
+    vk::Instance createInstance(const std::string &name, bool headless = false)
     {
         uint32_t version;
         vkEnumerateInstanceVersion(&version);
         std::cout << green("Vulkan version: ") << VK_VERSION_MAJOR(version) << "." << VK_VERSION_MINOR(version) << "." << VK_VERSION_PATCH(version) << std::endl;
 
-        version = VK_MAKE_API_VERSION(0, 1, 1, 0);
+        version = VK_MAKE_API_VERSION(0, 1, 2, 0);
 
         vk::ApplicationInfo appInfo(
             name.c_str(),
@@ -84,8 +85,10 @@ namespace ASHInit
             version);
 
         uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        const char **glfwExtensions = nullptr;
+        if (!headless) {
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        }
 
         std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
         std::vector<const char *> layers;
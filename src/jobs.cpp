@@ -0,0 +1,342 @@
+#include "jobs.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include <cmath>
+
+struct ASHUtil::Job {
+    std::function<void()> task;
+    JobCounter* counter;
+};
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // set on every thread a system owns, so jobs spawned from inside a job land on that thread's deque
+    thread_local const ASHUtil::JobSystem* t_system = nullptr;
+    thread_local size_t t_index = 0;
+}
+
+bool ASHUtil::JobCounter::isDone() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending == 0;
+}
+
+ASHUtil::JobSystem::JobSystem(size_t workerCount, bool pinThreads) {
+    for (size_t i = 0; i <= workerCount; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    m_statsStart = Clock::now();
+
+    for (size_t i = 1; i <= workerCount; ++i) {
+        m_threads.emplace_back(&JobSystem::workerLoop, this, i);
+
+        #ifdef __linux__
+        if (pinThreads) {
+            // the creating thread keeps core 0 to itself, the scheduler still moves it around
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cores);
+            pthread_setaffinity_np(m_threads.back().native_handle(), sizeof(cores), &cores);
+        }
+        #endif
+    }
+}
+
+ASHUtil::JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+size_t ASHUtil::JobSystem::defaultWorkerCount() {
+    return std::max(1u, std::thread::hardware_concurrency()) - 1;
+}
+
+size_t ASHUtil::JobSystem::size() const {
+    return m_workers.size();
+}
+
+size_t ASHUtil::JobSystem::currentIndex() const {
+    return t_system == this ? t_index : 0;
+}
+
+void ASHUtil::JobSystem::run(std::function<void()> task, JobCounter& counter) {
+    {
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        ++counter.m_pending;
+    }
+
+    push(new Job{std::move(task), &counter});
+}
+
+void ASHUtil::JobSystem::run(std::function<void()> task, JobCounter& counter, JobCounter& dependency) {
+    {
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        ++counter.m_pending;
+    }
+
+    Job* job = new Job{std::move(task), &counter};
+    {
+        // finish() takes the continuations under the same lock, so the job is either queued there or here
+        std::lock_guard<std::mutex> lock(dependency.m_mutex);
+        if (dependency.m_pending > 0) {
+            dependency.m_continuations.push_back(job);
+            return;
+        }
+    }
+
+    push(job);
+}
+
+void ASHUtil::JobSystem::wait(JobCounter& counter) {
+    size_t index = currentIndex();
+
+    while (!counter.isDone()) {
+        bool stolen;
+        Job* job = pop(index, stolen);
+        if (job) {
+            execute(job, index, stolen);
+        } else {
+            // what's left is running on other threads
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        error = counter.m_error;
+        counter.m_error = nullptr;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ASHUtil::JobSystem::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+
+    // a few chunks per thread are enough for stealing to even out uneven ones, more only add spawn overhead
+    size_t chunkLimit = 4 * size();
+    grainSize = std::max({grainSize, size_t(1), (count + chunkLimit - 1) / chunkLimit});
+
+    if (size() == 1 || count <= grainSize) {
+        task(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += grainSize) {
+        size_t end = std::min(begin + grainSize, count);
+        run([&task, begin, end] { task(begin, end); }, counter);
+    }
+
+    wait(counter);
+}
+
+std::vector<ASHUtil::WorkerStats> ASHUtil::JobSystem::getStats() const {
+    double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - m_statsStart).count();
+
+    std::vector<WorkerStats> stats;
+    for (const std::unique_ptr<Worker>& worker : m_workers) {
+        WorkerStats entry;
+        entry.jobs = worker->executed;
+        entry.stolen = worker->stolen;
+        entry.busyMs = worker->busyNs / 1e6;
+        entry.utilization = wallMs > 0.0 ? entry.busyMs / wallMs : 0.0;
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+void ASHUtil::JobSystem::resetStats() {
+    for (std::unique_ptr<Worker>& worker : m_workers) {
+        worker->executed = 0;
+        worker->stolen = 0;
+        worker->busyNs = 0;
+    }
+    m_statsStart = Clock::now();
+}
+
+void ASHUtil::JobSystem::push(Job* job) {
+    // counted before it can be popped, so the count never drops below zero
+    ++m_queued;
+
+    Worker& worker = *m_workers[currentIndex()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(job);
+    }
+
+    // taking the lock orders this against a worker that just found nothing and is about to sleep
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_one();
+}
+
+ASHUtil::Job* ASHUtil::JobSystem::pop(size_t index, bool& stolen) {
+    // newest first from the own deque, it is the most likely to still be in cache
+    {
+        Worker& worker = *m_workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.jobs.empty()) {
+            Job* job = worker.jobs.back();
+            worker.jobs.pop_back();
+            --m_queued;
+            stolen = false;
+            return job;
+        }
+    }
+
+    // oldest first from the others, those tend to be the largest pieces left
+    for (size_t i = 1; i < m_workers.size(); ++i) {
+        Worker& victim = *m_workers[(index + i) % m_workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            Job* job = victim.jobs.front();
+            victim.jobs.pop_front();
+            --m_queued;
+            stolen = true;
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+void ASHUtil::JobSystem::execute(Job* job, size_t index, bool stolen) {
+    Clock::time_point start = Clock::now();
+
+    // a worker thread has nowhere to throw to, the waiter gets it instead
+    std::exception_ptr error;
+    try {
+        job->task();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    Worker& worker = *m_workers[index];
+    worker.busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    ++worker.executed;
+    if (stolen) {
+        ++worker.stolen;
+    }
+
+    finish(*job->counter, error);
+    delete job;
+}
+
+void ASHUtil::JobSystem::finish(JobCounter& counter, std::exception_ptr error) {
+    std::vector<Job*> continuations;
+    {
+        // the waiter may free the counter as soon as it sees zero, so it is not touched after this lock
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        if (error && !counter.m_error) {
+            counter.m_error = error;
+        }
+        if (--counter.m_pending == 0) {
+            continuations.swap(counter.m_continuations);
+        }
+    }
+
+    for (Job* job : continuations) {
+        push(job);
+    }
+}
+
+void ASHUtil::JobSystem::workerLoop(size_t index) {
+    t_system = this;
+    t_index = index;
+
+    while (true) {
+        bool stolen;
+        Job* job = pop(index, stolen);
+        if (job) {
+            execute(job, index, stolen);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_stop || m_queued > 0; });
+        if (m_stop) {
+            return;
+        }
+    }
+}
+
+#ifdef BENCHMARK
+void ASHUtil::JobSystem::benchmark() {
+    constexpr size_t spawnCount = 1 << 16;
+    constexpr size_t itemCount = 1 << 20;
+    constexpr int repeats = 8;
+
+    std::vector<float> items(itemCount);
+    for (size_t i = 0; i < itemCount; ++i) {
+        items[i] = static_cast<float>(i);
+    }
+
+    // enough arithmetic per item that the loop is bound by the cores, not memory
+    auto kernel = [&items](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            float x = items[i];
+            for (int k = 0; k < 16; ++k) {
+                x = std::sqrt(x * 1.0001f + 1.0f);
+            }
+            items[i] = x;
+        }
+    };
+
+    auto msSince = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    std::cout << yellow("Job system benchmark:") << std::endl;
+
+    {
+        JobSystem jobs;
+        JobCounter counter;
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < spawnCount; ++i) {
+            jobs.run([] {}, counter);
+        }
+        jobs.wait(counter);
+        std::cout << "\tspawn and run an empty job: " << msSince(start) * 1e6 / spawnCount << " ns on " << jobs.size() << " threads" << std::endl;
+    }
+
+    double singleMs = 0.0;
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < defaultWorkerCount() + 1; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(defaultWorkerCount() + 1);
+
+    for (size_t threads : threadCounts) {
+        JobSystem jobs(threads - 1);
+
+        Clock::time_point start = Clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            jobs.parallelFor(itemCount, 1024, kernel);
+        }
+        double ms = msSince(start) / repeats;
+        if (threads == 1) {
+            singleMs = ms;
+        }
+
+        std::cout << "\tparallelFor over " << itemCount << " items on " << threads << " threads: " << ms << " ms, "
+            << singleMs / ms << "x" << std::endl;
+    }
+}
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "libs.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <exception>
+
+namespace ASHUtil {
+    struct Job;
+
+    // unfinished jobs of a batch, jobs queued with it as their dependency start once it reaches zero
+    // a counter can be reused for the next batch once wait() returned for it
+    class JobCounter {
+        public:
+            bool isDone();
+
+        private:
+            friend class JobSystem;
+
+            std::mutex m_mutex;
+            uint32_t m_pending = 0;
+            std::vector<Job*> m_continuations;
+            std::exception_ptr m_error; // the first job that threw, rethrown by wait()
+    };
+
+    // since the last resetStats
+    struct WorkerStats {
+        uint64_t jobs = 0;
+        uint64_t stolen = 0; // taken from another thread's deque
+        double busyMs = 0.0;
+        double utilization = 0.0; // busy share of the wall time
+    };
+
+    // work stealing scheduler: each thread, the creating one included, owns a deque it pushes to and pops from
+    // at the back, threads that run out of work steal from the front of the others
+    class JobSystem {
+        public:
+            // workerCount threads besides the creating one, pinned to one core each if pinThreads is set
+            explicit JobSystem(size_t workerCount = defaultWorkerCount(), bool pinThreads = false);
+            ~JobSystem();
+
+            JobSystem(const JobSystem&) = delete;
+            JobSystem& operator=(const JobSystem&) = delete;
+
+            // enough workers for one thread per core, the creating thread takes the remaining one
+            static size_t defaultWorkerCount();
+
+            // threads that run jobs, including the creating one
+            size_t size() const;
+
+            // queues task on the calling thread's deque, counter drops back once it ran
+            void run(std::function<void()> task, JobCounter& counter);
+
+            // the same, but the task is only queued once dependency reached zero
+            void run(std::function<void()> task, JobCounter& counter, JobCounter& dependency);
+
+            // runs queued jobs on the calling thread until counter reaches zero, rethrows if one of its jobs threw
+            void wait(JobCounter& counter);
+
+            // runs task(begin, end) over [0, count) in chunks of at least grainSize and returns once every chunk is done
+            void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& task);
+
+            // one entry per thread, the creating thread first
+            std::vector<WorkerStats> getStats() const;
+            void resetStats();
+
+            #ifdef BENCHMARK
+            // spawn overhead and parallelFor scaling over systems of 1 to defaultWorkerCount() + 1 threads
+            static void benchmark();
+            #endif
+
+        private:
+            struct Worker {
+                std::mutex mutex;
+                std::deque<Job*> jobs;
+
+                std::atomic<uint64_t> executed{0};
+                std::atomic<uint64_t> stolen{0};
+                std::atomic<uint64_t> busyNs{0};
+            };
+
+            std::vector<std::unique_ptr<Worker>> m_workers; // index 0 belongs to the creating thread
+            std::vector<std::thread> m_threads;
+
+            // idle workers sleep until something is queued
+            std::mutex m_sleepMutex;
+            std::condition_variable m_wake;
+            std::atomic<size_t> m_queued{0};
+            std::atomic<bool> m_stop{false};
+
+            std::chrono::steady_clock::time_point m_statsStart;
+
+            // threads outside the system use the creating thread's deque
+            size_t currentIndex() const;
+
+            void push(Job* job);
+            Job* pop(size_t index, bool& stolen);
+            void execute(Job* job, size_t index, bool stolen);
+            void finish(JobCounter& counter, std::exception_ptr error);
+            void workerLoop(size_t index);
+    };
+}
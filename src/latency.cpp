@@ -0,0 +1,58 @@
+#include "latency.hpp"
+
+ASHUtil::FrameLatencyTracker::FrameLatencyTracker(vk::Device device, vk::Semaphore timeline) : m_device(device), m_timeline(timeline) {
+    m_worker = std::thread(&FrameLatencyTracker::workerLoop, this);
+}
+
+ASHUtil::FrameLatencyTracker::~FrameLatencyTracker() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    m_worker.join();
+}
+
+void ASHUtil::FrameLatencyTracker::track(uint64_t value, std::chrono::steady_clock::time_point frameStart) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frames.emplace_back(value, frameStart);
+    }
+    m_wake.notify_one();
+}
+
+double ASHUtil::FrameLatencyTracker::getLatencyMs() const {
+    return m_latencyMs.load(std::memory_order_relaxed);
+}
+
+void ASHUtil::FrameLatencyTracker::workerLoop() {
+    while (true) {
+        std::pair<uint64_t, std::chrono::steady_clock::time_point> frame;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stop || !m_frames.empty(); });
+            if (m_stop) {
+                return;
+            }
+            frame = m_frames.front();
+        }
+
+        vk::SemaphoreWaitInfo waitInfo{};
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &m_timeline;
+        waitInfo.pValues = &frame.first;
+
+        // short timeouts keep shutdown from hanging on a frame that is never submitted
+        if (m_device.waitSemaphores(waitInfo, 10'000'000) != vk::Result::eSuccess) {
+            continue;
+        }
+
+        double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.second).count();
+        double smoothed = m_latencyMs.load(std::memory_order_relaxed);
+        m_latencyMs.store(smoothed == 0.0 ? latency : smoothed + (latency - smoothed) * 0.05, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frames.pop_front();
+    }
+}
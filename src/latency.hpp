@@ -0,0 +1,43 @@
+#pragma once
+
+#include "libs.hpp"
+
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+
+namespace ASHUtil {
+    // waits on a timeline semaphore from its own thread, so a frame's GPU completion is timed when it happens
+    // rather than whenever the render loop next checks
+    class FrameLatencyTracker {
+        public:
+            FrameLatencyTracker(vk::Device device, vk::Semaphore timeline);
+            ~FrameLatencyTracker();
+
+            FrameLatencyTracker(const FrameLatencyTracker&) = delete;
+            FrameLatencyTracker& operator=(const FrameLatencyTracker&) = delete;
+
+            // the frame started on the CPU at frameStart and finishes on the GPU when the timeline reaches value
+            void track(uint64_t value, std::chrono::steady_clock::time_point frameStart);
+
+            // frame start to GPU completion, smoothed over roughly the last 20 frames
+            double getLatencyMs() const;
+
+        private:
+            vk::Device m_device;
+            vk::Semaphore m_timeline;
+
+            std::thread m_worker;
+            std::mutex m_mutex;
+            std::condition_variable m_wake;
+            bool m_stop = false;
+            std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> m_frames;
+
+            std::atomic<double> m_latencyMs{0.0};
+
+            void workerLoop();
+    };
+}
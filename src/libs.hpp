@@ -9,6 +9,7 @@
 #include <optional>
 #include <fstream>
 #include <unordered_map>
+#include <algorithm>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -17,7 +18,7 @@
 
 
 #define DEBUG
-#define FORCE_IMMEDIATE_PRESENT
+// #define BENCHMARK // run startup microbenchmarks
 
 // function to make text green
 inline std::string green(const std::string &text) {
@@ -56,5 +57,8 @@ enum class meshTypes {
 	SKULL
 };
 
+// meshTypes doubles as the material index, keep in sync with shader.frag
+constexpr uint32_t meshTypeCount = 3;
+
 
 std::vector<std::string> split(std::string line, std::string delimiter);
\ No newline at end of file
@@ -0,0 +1,707 @@
+#include "mathkernels.hpp"
+
+#include <atomic>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ASH_MATH_X86
+#include <immintrin.h>
+
+// kernels are compiled per target so the rest of the build keeps the baseline ISA
+#define ASH_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define ASH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+using ASHMath::AABB;
+using ASHMath::Mat3x4;
+using ASHMath::Transform;
+
+namespace {
+    struct KernelTable {
+        void (*composeTransforms)(const Transform*, glm::mat4*, size_t);
+        void (*composeTransforms3x4)(const Transform*, Mat3x4*, size_t);
+        void (*multiplyMatrices)(const glm::mat4*, const glm::mat4*, glm::mat4*, size_t);
+        void (*premultiplyMatrices)(const glm::mat4&, const glm::mat4*, glm::mat4*, size_t);
+        void (*transformAABBs)(const glm::mat4*, const AABB*, AABB*, size_t);
+        size_t (*testSpheres)(const glm::vec4*, size_t, const glm::vec4*, size_t, uint8_t*);
+    };
+
+    // Scalar
+
+    // columns of R * S for a unit quaternion, the SIMD paths below follow the same terms
+    inline void rotationScale(const Transform& t, float c[3][3]) {
+        float x = t.rotation.x, y = t.rotation.y, z = t.rotation.z, w = t.rotation.w;
+        float x2 = x + x, y2 = y + y, z2 = z + z;
+        float xx = x * x2, yy = y * y2, zz = z * z2;
+        float xy = x * y2, xz = x * z2, yz = y * z2;
+        float wx = w * x2, wy = w * y2, wz = w * z2;
+
+        c[0][0] = (1.0f - (yy + zz)) * t.scale.x;
+        c[0][1] = (xy + wz) * t.scale.x;
+        c[0][2] = (xz - wy) * t.scale.x;
+
+        c[1][0] = (xy - wz) * t.scale.y;
+        c[1][1] = (1.0f - (xx + zz)) * t.scale.y;
+        c[1][2] = (yz + wx) * t.scale.y;
+
+        c[2][0] = (xz + wy) * t.scale.z;
+        c[2][1] = (yz - wx) * t.scale.z;
+        c[2][2] = (1.0f - (xx + yy)) * t.scale.z;
+    }
+
+    void composeTransformsScalar(const Transform* transforms, glm::mat4* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            float c[3][3];
+            rotationScale(transforms[i], c);
+
+            out[i][0] = glm::vec4(c[0][0], c[0][1], c[0][2], 0.0f);
+            out[i][1] = glm::vec4(c[1][0], c[1][1], c[1][2], 0.0f);
+            out[i][2] = glm::vec4(c[2][0], c[2][1], c[2][2], 0.0f);
+            out[i][3] = glm::vec4(transforms[i].position, 1.0f);
+        }
+    }
+
+    void composeTransforms3x4Scalar(const Transform* transforms, Mat3x4* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            float c[3][3];
+            rotationScale(transforms[i], c);
+
+            for (int row = 0; row < 3; ++row) {
+                out[i].m[row][0] = c[0][row];
+                out[i].m[row][1] = c[1][row];
+                out[i].m[row][2] = c[2][row];
+                out[i].m[row][3] = transforms[i].position[row];
+            }
+        }
+    }
+
+    void multiplyMatricesScalar(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = lhs[i] * rhs[i];
+        }
+    }
+
+    void premultiplyMatricesScalar(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+        glm::mat4 left = lhs;
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = left * rhs[i];
+        }
+    }
+
+    void transformAABBsScalar(const glm::mat4* matrices, const AABB* boxes, AABB* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const glm::mat4& m = matrices[i];
+            glm::vec3 center = (boxes[i].min + boxes[i].max) * 0.5f;
+            glm::vec3 extent = (boxes[i].max - boxes[i].min) * 0.5f;
+
+            glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+            glm::vec3 worldExtent = glm::abs(glm::vec3(m[0])) * extent.x
+                + glm::abs(glm::vec3(m[1])) * extent.y
+                + glm::abs(glm::vec3(m[2])) * extent.z;
+
+            out[i].min = worldCenter - worldExtent;
+            out[i].max = worldCenter + worldExtent;
+        }
+    }
+
+    size_t testSpheresScalar(const glm::vec4* spheres, size_t count, const glm::vec4* planes, size_t planeCount, uint8_t* visible) {
+        size_t visibleCount = 0;
+        for (size_t i = 0; i < count; ++i) {
+            bool inside = true;
+            for (size_t p = 0; p < planeCount; ++p) {
+                float distance = planes[p].x * spheres[i].x + planes[p].y * spheres[i].y + planes[p].z * spheres[i].z + planes[p].w;
+                inside = inside && distance >= -spheres[i].w;
+            }
+            visible[i] = inside ? 1 : 0;
+            visibleCount += inside ? 1 : 0;
+        }
+        return visibleCount;
+    }
+
+    #ifdef ASH_MATH_X86
+
+    // SSE4.1
+
+    struct RotationScale4 {
+        __m128 c00, c01, c02;
+        __m128 c10, c11, c12;
+        __m128 c20, c21, c22;
+        __m128 px, py, pz;
+    };
+
+    // gathers four transforms into SoA registers and evaluates R * S for all of them
+    ASH_TARGET_SSE41 inline RotationScale4 rotationScaleSSE(const Transform* t) {
+        __m128 qx = _mm_setr_ps(t[0].rotation.x, t[1].rotation.x, t[2].rotation.x, t[3].rotation.x);
+        __m128 qy = _mm_setr_ps(t[0].rotation.y, t[1].rotation.y, t[2].rotation.y, t[3].rotation.y);
+        __m128 qz = _mm_setr_ps(t[0].rotation.z, t[1].rotation.z, t[2].rotation.z, t[3].rotation.z);
+        __m128 qw = _mm_setr_ps(t[0].rotation.w, t[1].rotation.w, t[2].rotation.w, t[3].rotation.w);
+        __m128 sx = _mm_setr_ps(t[0].scale.x, t[1].scale.x, t[2].scale.x, t[3].scale.x);
+        __m128 sy = _mm_setr_ps(t[0].scale.y, t[1].scale.y, t[2].scale.y, t[3].scale.y);
+        __m128 sz = _mm_setr_ps(t[0].scale.z, t[1].scale.z, t[2].scale.z, t[3].scale.z);
+
+        __m128 x2 = _mm_add_ps(qx, qx), y2 = _mm_add_ps(qy, qy), z2 = _mm_add_ps(qz, qz);
+        __m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2), zz = _mm_mul_ps(qz, z2);
+        __m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2), yz = _mm_mul_ps(qy, z2);
+        __m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2), wz = _mm_mul_ps(qw, z2);
+        __m128 one = _mm_set1_ps(1.0f);
+
+        RotationScale4 r;
+        r.c00 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+        r.c01 = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+        r.c02 = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+
+        r.c10 = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+        r.c11 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+        r.c12 = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+
+        r.c20 = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+        r.c21 = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+        r.c22 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+
+        r.px = _mm_setr_ps(t[0].position.x, t[1].position.x, t[2].position.x, t[3].position.x);
+        r.py = _mm_setr_ps(t[0].position.y, t[1].position.y, t[2].position.y, t[3].position.y);
+        r.pz = _mm_setr_ps(t[0].position.z, t[1].position.z, t[2].position.z, t[3].position.z);
+        return r;
+    }
+
+    // transposes four SoA component registers into one vec4 per transform
+    ASH_TARGET_SSE41 inline void storeTransposed(__m128 a, __m128 b, __m128 c, __m128 d, float* out0, float* out1, float* out2, float* out3) {
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _mm_storeu_ps(out0, a);
+        _mm_storeu_ps(out1, b);
+        _mm_storeu_ps(out2, c);
+        _mm_storeu_ps(out3, d);
+    }
+
+    ASH_TARGET_SSE41 void storeColumns(const RotationScale4& r, glm::mat4* out) {
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        storeTransposed(r.c00, r.c01, r.c02, zero, &out[0][0][0], &out[1][0][0], &out[2][0][0], &out[3][0][0]);
+        storeTransposed(r.c10, r.c11, r.c12, zero, &out[0][1][0], &out[1][1][0], &out[2][1][0], &out[3][1][0]);
+        storeTransposed(r.c20, r.c21, r.c22, zero, &out[0][2][0], &out[1][2][0], &out[2][2][0], &out[3][2][0]);
+        storeTransposed(r.px, r.py, r.pz, one, &out[0][3][0], &out[1][3][0], &out[2][3][0], &out[3][3][0]);
+    }
+
+    ASH_TARGET_SSE41 void storeRows(const RotationScale4& r, Mat3x4* out) {
+        storeTransposed(r.c00, r.c10, r.c20, r.px, out[0].m[0], out[1].m[0], out[2].m[0], out[3].m[0]);
+        storeTransposed(r.c01, r.c11, r.c21, r.py, out[0].m[1], out[1].m[1], out[2].m[1], out[3].m[1]);
+        storeTransposed(r.c02, r.c12, r.c22, r.pz, out[0].m[2], out[1].m[2], out[2].m[2], out[3].m[2]);
+    }
+
+    ASH_TARGET_SSE41 void composeTransformsSSE(const Transform* transforms, glm::mat4* out, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            storeColumns(rotationScaleSSE(transforms + i), out + i);
+        }
+        composeTransformsScalar(transforms + i, out + i, count - i);
+    }
+
+    ASH_TARGET_SSE41 void composeTransforms3x4SSE(const Transform* transforms, Mat3x4* out, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            storeRows(rotationScaleSSE(transforms + i), out + i);
+        }
+        composeTransforms3x4Scalar(transforms + i, out + i, count - i);
+    }
+
+    // columns of lhs must already be loaded, rhs is read fully before out is written
+    ASH_TARGET_SSE41 inline void multiplySSE(__m128 a0, __m128 a1, __m128 a2, __m128 a3, const float* rhs, float* out) {
+        __m128 b0 = _mm_loadu_ps(rhs);
+        __m128 b1 = _mm_loadu_ps(rhs + 4);
+        __m128 b2 = _mm_loadu_ps(rhs + 8);
+        __m128 b3 = _mm_loadu_ps(rhs + 12);
+        __m128 b[4] = {b0, b1, b2, b3};
+
+        for (int j = 0; j < 4; ++j) {
+            __m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(b[j], b[j], _MM_SHUFFLE(0, 0, 0, 0)));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(b[j], b[j], _MM_SHUFFLE(1, 1, 1, 1))));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(b[j], b[j], _MM_SHUFFLE(2, 2, 2, 2))));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(b[j], b[j], _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm_storeu_ps(out + 4 * j, r);
+        }
+    }
+
+    ASH_TARGET_SSE41 void multiplyMatricesSSE(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const float* a = &lhs[i][0][0];
+            multiplySSE(_mm_loadu_ps(a), _mm_loadu_ps(a + 4), _mm_loadu_ps(a + 8), _mm_loadu_ps(a + 12), &rhs[i][0][0], &out[i][0][0]);
+        }
+    }
+
+    ASH_TARGET_SSE41 void premultiplyMatricesSSE(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+        const float* a = &lhs[0][0];
+        __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+        for (size_t i = 0; i < count; ++i) {
+            multiplySSE(a0, a1, a2, a3, &rhs[i][0][0], &out[i][0][0]);
+        }
+    }
+
+    ASH_TARGET_SSE41 inline void storeBox(__m128 center, __m128 extent, AABB& out) {
+        alignas(16) float lo[4], hi[4];
+        _mm_store_ps(lo, _mm_sub_ps(center, extent));
+        _mm_store_ps(hi, _mm_add_ps(center, extent));
+        out.min = glm::vec3(lo[0], lo[1], lo[2]);
+        out.max = glm::vec3(hi[0], hi[1], hi[2]);
+    }
+
+    ASH_TARGET_SSE41 void transformAABBsSSE(const glm::mat4* matrices, const AABB* boxes, AABB* out, size_t count) {
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+        for (size_t i = 0; i < count; ++i) {
+            const float* m = &matrices[i][0][0];
+            __m128 m0 = _mm_loadu_ps(m), m1 = _mm_loadu_ps(m + 4), m2 = _mm_loadu_ps(m + 8), m3 = _mm_loadu_ps(m + 12);
+
+            __m128 lo = _mm_setr_ps(boxes[i].min.x, boxes[i].min.y, boxes[i].min.z, 0.0f);
+            __m128 hi = _mm_setr_ps(boxes[i].max.x, boxes[i].max.y, boxes[i].max.z, 0.0f);
+            __m128 c = _mm_mul_ps(_mm_add_ps(lo, hi), half);
+            __m128 e = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+
+            __m128 center = _mm_add_ps(m3, _mm_mul_ps(m0, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0))));
+            center = _mm_add_ps(center, _mm_mul_ps(m1, _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1))));
+            center = _mm_add_ps(center, _mm_mul_ps(m2, _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))));
+
+            __m128 extent = _mm_mul_ps(_mm_and_ps(m0, absMask), _mm_shuffle_ps(e, e, _MM_SHUFFLE(0, 0, 0, 0)));
+            extent = _mm_add_ps(extent, _mm_mul_ps(_mm_and_ps(m1, absMask), _mm_shuffle_ps(e, e, _MM_SHUFFLE(1, 1, 1, 1))));
+            extent = _mm_add_ps(extent, _mm_mul_ps(_mm_and_ps(m2, absMask), _mm_shuffle_ps(e, e, _MM_SHUFFLE(2, 2, 2, 2))));
+
+            storeBox(center, extent, out[i]);
+        }
+    }
+
+    // returns a 4 bit mask of the spheres inside every plane
+    ASH_TARGET_SSE41 inline int testSpheres4(const glm::vec4* spheres, const glm::vec4* planes, size_t planeCount) {
+        __m128 cx = _mm_loadu_ps(&spheres[0][0]);
+        __m128 cy = _mm_loadu_ps(&spheres[1][0]);
+        __m128 cz = _mm_loadu_ps(&spheres[2][0]);
+        __m128 r = _mm_loadu_ps(&spheres[3][0]);
+        _MM_TRANSPOSE4_PS(cx, cy, cz, r);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (size_t p = 0; p < planeCount; ++p) {
+            __m128 d = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes[p].x)), _mm_set1_ps(planes[p].w));
+            d = _mm_add_ps(d, _mm_mul_ps(cy, _mm_set1_ps(planes[p].y)));
+            d = _mm_add_ps(d, _mm_mul_ps(cz, _mm_set1_ps(planes[p].z)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+        return _mm_movemask_ps(inside);
+    }
+
+    ASH_TARGET_SSE41 size_t testSpheresSSE(const glm::vec4* spheres, size_t count, const glm::vec4* planes, size_t planeCount, uint8_t* visible) {
+        size_t visibleCount = 0;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            int mask = testSpheres4(spheres + i, planes, planeCount);
+            for (int k = 0; k < 4; ++k) {
+                visible[i + k] = (mask >> k) & 1;
+            }
+            visibleCount += __builtin_popcount(mask);
+        }
+        return visibleCount + testSpheresScalar(spheres + i, count - i, planes, planeCount, visible + i);
+    }
+
+    // AVX2
+
+    struct RotationScale8 {
+        __m256 c00, c01, c02;
+        __m256 c10, c11, c12;
+        __m256 c20, c21, c22;
+        __m256 px, py, pz;
+    };
+
+    #define ASH_GATHER8(t, field) _mm256_setr_ps(t[0].field, t[1].field, t[2].field, t[3].field, t[4].field, t[5].field, t[6].field, t[7].field)
+
+    ASH_TARGET_AVX2 inline RotationScale8 rotationScaleAVX(const Transform* t) {
+        __m256 qx = ASH_GATHER8(t, rotation.x);
+        __m256 qy = ASH_GATHER8(t, rotation.y);
+        __m256 qz = ASH_GATHER8(t, rotation.z);
+        __m256 qw = ASH_GATHER8(t, rotation.w);
+        __m256 sx = ASH_GATHER8(t, scale.x);
+        __m256 sy = ASH_GATHER8(t, scale.y);
+        __m256 sz = ASH_GATHER8(t, scale.z);
+
+        __m256 x2 = _mm256_add_ps(qx, qx), y2 = _mm256_add_ps(qy, qy), z2 = _mm256_add_ps(qz, qz);
+        __m256 xx = _mm256_mul_ps(qx, x2), yy = _mm256_mul_ps(qy, y2), zz = _mm256_mul_ps(qz, z2);
+        __m256 xy = _mm256_mul_ps(qx, y2), xz = _mm256_mul_ps(qx, z2), yz = _mm256_mul_ps(qy, z2);
+        __m256 wx = _mm256_mul_ps(qw, x2), wy = _mm256_mul_ps(qw, y2), wz = _mm256_mul_ps(qw, z2);
+        __m256 one = _mm256_set1_ps(1.0f);
+
+        RotationScale8 r;
+        r.c00 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx);
+        r.c01 = _mm256_mul_ps(_mm256_add_ps(xy, wz), sx);
+        r.c02 = _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx);
+
+        r.c10 = _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy);
+        r.c11 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy);
+        r.c12 = _mm256_mul_ps(_mm256_add_ps(yz, wx), sy);
+
+        r.c20 = _mm256_mul_ps(_mm256_add_ps(xz, wy), sz);
+        r.c21 = _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz);
+        r.c22 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz);
+
+        r.px = ASH_GATHER8(t, position.x);
+        r.py = ASH_GATHER8(t, position.y);
+        r.pz = ASH_GATHER8(t, position.z);
+        return r;
+    }
+
+    #undef ASH_GATHER8
+
+    // AVX copies of the SSE transpose helpers, calling the legacy encoded ones from here would
+    // pay an SSE/AVX transition on every store
+    ASH_TARGET_AVX2 inline __m128 lane(__m256 v, bool upper) {
+        return upper ? _mm256_extractf128_ps(v, 1) : _mm256_castps256_ps128(v);
+    }
+
+    ASH_TARGET_AVX2 inline void storeTransposedAVX(__m256 a, __m256 b, __m256 c, __m256 d, bool upper, float* out0, float* out1, float* out2, float* out3) {
+        __m128 a4 = lane(a, upper), b4 = lane(b, upper), c4 = lane(c, upper), d4 = lane(d, upper);
+        _MM_TRANSPOSE4_PS(a4, b4, c4, d4);
+        _mm_storeu_ps(out0, a4);
+        _mm_storeu_ps(out1, b4);
+        _mm_storeu_ps(out2, c4);
+        _mm_storeu_ps(out3, d4);
+    }
+
+    ASH_TARGET_AVX2 inline void storeColumnsAVX(const RotationScale8& r, bool upper, glm::mat4* out) {
+        __m256 zero = _mm256_setzero_ps();
+        __m256 one = _mm256_set1_ps(1.0f);
+        storeTransposedAVX(r.c00, r.c01, r.c02, zero, upper, &out[0][0][0], &out[1][0][0], &out[2][0][0], &out[3][0][0]);
+        storeTransposedAVX(r.c10, r.c11, r.c12, zero, upper, &out[0][1][0], &out[1][1][0], &out[2][1][0], &out[3][1][0]);
+        storeTransposedAVX(r.c20, r.c21, r.c22, zero, upper, &out[0][2][0], &out[1][2][0], &out[2][2][0], &out[3][2][0]);
+        storeTransposedAVX(r.px, r.py, r.pz, one, upper, &out[0][3][0], &out[1][3][0], &out[2][3][0], &out[3][3][0]);
+    }
+
+    ASH_TARGET_AVX2 inline void storeRowsAVX(const RotationScale8& r, bool upper, Mat3x4* out) {
+        storeTransposedAVX(r.c00, r.c10, r.c20, r.px, upper, out[0].m[0], out[1].m[0], out[2].m[0], out[3].m[0]);
+        storeTransposedAVX(r.c01, r.c11, r.c21, r.py, upper, out[0].m[1], out[1].m[1], out[2].m[1], out[3].m[1]);
+        storeTransposedAVX(r.c02, r.c12, r.c22, r.pz, upper, out[0].m[2], out[1].m[2], out[2].m[2], out[3].m[2]);
+    }
+
+    ASH_TARGET_AVX2 void composeTransformsAVX(const Transform* transforms, glm::mat4* out, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            RotationScale8 r = rotationScaleAVX(transforms + i);
+            storeColumnsAVX(r, false, out + i);
+            storeColumnsAVX(r, true, out + i + 4);
+        }
+        composeTransformsSSE(transforms + i, out + i, count - i);
+    }
+
+    ASH_TARGET_AVX2 void composeTransforms3x4AVX(const Transform* transforms, Mat3x4* out, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            RotationScale8 r = rotationScaleAVX(transforms + i);
+            storeRowsAVX(r, false, out + i);
+            storeRowsAVX(r, true, out + i + 4);
+        }
+        composeTransforms3x4SSE(transforms + i, out + i, count - i);
+    }
+
+    // computes two result columns per iteration, lhs columns are duplicated into both lanes
+    ASH_TARGET_AVX2 inline void multiplyAVX(__m256 a0, __m256 a1, __m256 a2, __m256 a3, const float* rhs, float* out) {
+        __m256 b01 = _mm256_loadu_ps(rhs);
+        __m256 b23 = _mm256_loadu_ps(rhs + 8);
+        __m256 b[2] = {b01, b23};
+
+        for (int j = 0; j < 2; ++j) {
+            __m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(b[j], 0x00));
+            r = _mm256_fmadd_ps(a1, _mm256_permute_ps(b[j], 0x55), r);
+            r = _mm256_fmadd_ps(a2, _mm256_permute_ps(b[j], 0xAA), r);
+            r = _mm256_fmadd_ps(a3, _mm256_permute_ps(b[j], 0xFF), r);
+            _mm256_storeu_ps(out + 8 * j, r);
+        }
+    }
+
+    ASH_TARGET_AVX2 void multiplyMatricesAVX(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const float* a = &lhs[i][0][0];
+            __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+            __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+            __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+            __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+            multiplyAVX(a0, a1, a2, a3, &rhs[i][0][0], &out[i][0][0]);
+        }
+    }
+
+    ASH_TARGET_AVX2 void premultiplyMatricesAVX(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+        const float* a = &lhs[0][0];
+        __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+        __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+        __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+        __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+        for (size_t i = 0; i < count; ++i) {
+            multiplyAVX(a0, a1, a2, a3, &rhs[i][0][0], &out[i][0][0]);
+        }
+    }
+
+    ASH_TARGET_AVX2 inline void storeBoxAVX(__m128 center, __m128 extent, AABB& out) {
+        alignas(16) float lo[4], hi[4];
+        _mm_store_ps(lo, _mm_sub_ps(center, extent));
+        _mm_store_ps(hi, _mm_add_ps(center, extent));
+        out.min = glm::vec3(lo[0], lo[1], lo[2]);
+        out.max = glm::vec3(hi[0], hi[1], hi[2]);
+    }
+
+    ASH_TARGET_AVX2 inline __m256 loadPair(const float* lower, const float* upper) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lower)), _mm_loadu_ps(upper), 1);
+    }
+
+    // two boxes per iteration, one per 128 bit lane
+    ASH_TARGET_AVX2 void transformAABBsAVX(const glm::mat4* matrices, const AABB* boxes, AABB* out, size_t count) {
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            const float* a = &matrices[i][0][0];
+            const float* b = &matrices[i + 1][0][0];
+            __m256 m0 = loadPair(a, b), m1 = loadPair(a + 4, b + 4), m2 = loadPair(a + 8, b + 8), m3 = loadPair(a + 12, b + 12);
+
+            const AABB& p = boxes[i];
+            const AABB& q = boxes[i + 1];
+            __m256 lo = _mm256_setr_ps(p.min.x, p.min.y, p.min.z, 0.0f, q.min.x, q.min.y, q.min.z, 0.0f);
+            __m256 hi = _mm256_setr_ps(p.max.x, p.max.y, p.max.z, 0.0f, q.max.x, q.max.y, q.max.z, 0.0f);
+            __m256 c = _mm256_mul_ps(_mm256_add_ps(lo, hi), half);
+            __m256 e = _mm256_mul_ps(_mm256_sub_ps(hi, lo), half);
+
+            __m256 center = _mm256_fmadd_ps(m0, _mm256_permute_ps(c, 0x00), m3);
+            center = _mm256_fmadd_ps(m1, _mm256_permute_ps(c, 0x55), center);
+            center = _mm256_fmadd_ps(m2, _mm256_permute_ps(c, 0xAA), center);
+
+            __m256 extent = _mm256_mul_ps(_mm256_and_ps(m0, absMask), _mm256_permute_ps(e, 0x00));
+            extent = _mm256_fmadd_ps(_mm256_and_ps(m1, absMask), _mm256_permute_ps(e, 0x55), extent);
+            extent = _mm256_fmadd_ps(_mm256_and_ps(m2, absMask), _mm256_permute_ps(e, 0xAA), extent);
+
+            storeBoxAVX(_mm256_castps256_ps128(center), _mm256_castps256_ps128(extent), out[i]);
+            storeBoxAVX(_mm256_extractf128_ps(center, 1), _mm256_extractf128_ps(extent, 1), out[i + 1]);
+        }
+        transformAABBsSSE(matrices + i, boxes + i, out + i, count - i);
+    }
+
+    ASH_TARGET_AVX2 size_t testSpheresAVX(const glm::vec4* spheres, size_t count, const glm::vec4* planes, size_t planeCount, uint8_t* visible) {
+        size_t visibleCount = 0;
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128 x0 = _mm_loadu_ps(&spheres[i][0]), y0 = _mm_loadu_ps(&spheres[i + 1][0]);
+            __m128 z0 = _mm_loadu_ps(&spheres[i + 2][0]), r0 = _mm_loadu_ps(&spheres[i + 3][0]);
+            __m128 x1 = _mm_loadu_ps(&spheres[i + 4][0]), y1 = _mm_loadu_ps(&spheres[i + 5][0]);
+            __m128 z1 = _mm_loadu_ps(&spheres[i + 6][0]), r1 = _mm_loadu_ps(&spheres[i + 7][0]);
+            _MM_TRANSPOSE4_PS(x0, y0, z0, r0);
+            _MM_TRANSPOSE4_PS(x1, y1, z1, r1);
+
+            __m256 cx = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+            __m256 cy = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+            __m256 cz = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+            __m256 r = _mm256_insertf128_ps(_mm256_castps128_ps256(r0), r1, 1);
+            __m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), r);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (size_t p = 0; p < planeCount; ++p) {
+                __m256 d = _mm256_fmadd_ps(cx, _mm256_set1_ps(planes[p].x), _mm256_set1_ps(planes[p].w));
+                d = _mm256_fmadd_ps(cy, _mm256_set1_ps(planes[p].y), d);
+                d = _mm256_fmadd_ps(cz, _mm256_set1_ps(planes[p].z), d);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+            }
+
+            int mask = _mm256_movemask_ps(inside);
+            for (int k = 0; k < 8; ++k) {
+                visible[i + k] = (mask >> k) & 1;
+            }
+            visibleCount += __builtin_popcount(mask);
+        }
+        return visibleCount + testSpheresSSE(spheres + i, count - i, planes, planeCount, visible + i);
+    }
+
+    #endif
+
+    KernelTable makeTable(ASHMath::simdLevels level) {
+        KernelTable table = {
+            composeTransformsScalar,
+            composeTransforms3x4Scalar,
+            multiplyMatricesScalar,
+            premultiplyMatricesScalar,
+            transformAABBsScalar,
+            testSpheresScalar
+        };
+
+        #ifdef ASH_MATH_X86
+        if (level == ASHMath::simdLevels::SSE41) {
+            table = {
+                composeTransformsSSE,
+                composeTransforms3x4SSE,
+                multiplyMatricesSSE,
+                premultiplyMatricesSSE,
+                transformAABBsSSE,
+                testSpheresSSE
+            };
+        } else if (level == ASHMath::simdLevels::AVX2) {
+            table = {
+                composeTransformsAVX,
+                composeTransforms3x4AVX,
+                multiplyMatricesAVX,
+                premultiplyMatricesAVX,
+                transformAABBsAVX,
+                testSpheresAVX
+            };
+        }
+        #endif
+
+        return table;
+    }
+
+    // one immutable table per level, so switching levels only swaps an index
+    const KernelTable& tableFor(ASHMath::simdLevels level) {
+        static const KernelTable tables[] = {
+            makeTable(ASHMath::simdLevels::SCALAR),
+            makeTable(ASHMath::simdLevels::SSE41),
+            makeTable(ASHMath::simdLevels::AVX2)
+        };
+        return tables[static_cast<int>(level)];
+    }
+
+    // job threads read this while setSimdLevel may write it, calls already running keep their table
+    std::atomic<ASHMath::simdLevels>& currentLevel() {
+        static std::atomic<ASHMath::simdLevels> level{ASHMath::detectSimdLevel()};
+        return level;
+    }
+
+    const KernelTable& table() {
+        return tableFor(currentLevel().load(std::memory_order_relaxed));
+    }
+}
+
+ASHMath::simdLevels ASHMath::detectSimdLevel() {
+    #ifdef ASH_MATH_X86
+    // libgcc runs CPUID once and also checks that the OS saves the YMM registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return simdLevels::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return simdLevels::SSE41;
+    }
+    #endif
+    return simdLevels::SCALAR;
+}
+
+ASHMath::simdLevels ASHMath::getSimdLevel() {
+    return currentLevel().load(std::memory_order_relaxed);
+}
+
+void ASHMath::setSimdLevel(simdLevels level) {
+    simdLevels supported = detectSimdLevel();
+    if (static_cast<int>(level) > static_cast<int>(supported)) {
+        level = supported;
+    }
+    currentLevel().store(level, std::memory_order_relaxed);
+}
+
+std::string ASHMath::simdLevelName(simdLevels level) {
+    switch (level) {
+        case simdLevels::AVX2:
+            return "AVX2";
+        case simdLevels::SSE41:
+            return "SSE4.1";
+        default:
+            return "Scalar";
+    }
+}
+
+void ASHMath::composeTransforms(const Transform* transforms, glm::mat4* out, size_t count) {
+    table().composeTransforms(transforms, out, count);
+}
+
+void ASHMath::composeTransforms3x4(const Transform* transforms, Mat3x4* out, size_t count) {
+    table().composeTransforms3x4(transforms, out, count);
+}
+
+void ASHMath::multiplyMatrices(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+    table().multiplyMatrices(lhs, rhs, out, count);
+}
+
+void ASHMath::premultiplyMatrices(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+    table().premultiplyMatrices(lhs, rhs, out, count);
+}
+
+void ASHMath::transformAABBs(const glm::mat4* matrices, const AABB* boxes, AABB* out, size_t count) {
+    table().transformAABBs(matrices, boxes, out, count);
+}
+
+size_t ASHMath::testSpheres(const glm::vec4* spheres, size_t count, const glm::vec4* planes, size_t planeCount, uint8_t* visible) {
+    return table().testSpheres(spheres, count, planes, planeCount, visible);
+}
+
+void ASHMath::extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+    // glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[2];
+    planes[5] = rows[3] - rows[2];
+
+    for (int i = 0; i < 6; ++i) {
+        planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+    }
+}
+
+#ifdef BENCHMARK
+void ASHMath::benchmarkKernels() {
+    constexpr size_t count = 1 << 16;
+    constexpr int repeats = 32;
+
+    // the kernels are branch free apart from the sphere test, so only its inputs need to vary, the values are
+    // checked against GLM by tests/mathkernels.cpp
+    Transform transform = {glm::vec3(1.0f, 2.0f, 3.0f), glm::angleAxis(0.5f, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f))), glm::vec3(2.0f)};
+    std::vector<Transform> transforms(count, transform);
+    std::vector<glm::mat4> lhs(count, glm::mat4_cast(transform.rotation));
+    std::vector<glm::mat4> rhs(count, glm::translate(glm::mat4(1.0f), transform.position));
+    std::vector<AABB> inputBoxes(count, AABB{glm::vec3(-1.0f), glm::vec3(1.0f)});
+
+    // a row of spheres running out of the frustum on both sides
+    glm::vec4 planes[6];
+    extractFrustumPlanes(glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f), planes);
+    std::vector<glm::vec4> spheres(count);
+    for (size_t i = 0; i < count; ++i) {
+        spheres[i] = glm::vec4(static_cast<float>(i % 97) - 48.0f, 0.0f, -50.0f, 1.0f);
+    }
+
+    std::vector<glm::mat4> matrices(count);
+    std::vector<Mat3x4> affine(count);
+    std::vector<AABB> boxes(count);
+    std::vector<uint8_t> visible(count);
+
+    auto nsPerItem = [&](auto&& kernel) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            kernel();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / (double(count) * repeats);
+    };
+
+    simdLevels previous = getSimdLevel();
+    simdLevels supported = detectSimdLevel();
+
+    std::cout << yellow("Math kernel benchmark (ns per item):") << std::endl;
+    for (int l = 0; l <= static_cast<int>(supported); ++l) {
+        setSimdLevel(static_cast<simdLevels>(l));
+
+        std::cout << "\t" << simdLevelName(static_cast<simdLevels>(l)) << std::endl;
+        std::cout << "\t\tcompose TRS -> mat4: " << nsPerItem([&] { composeTransforms(transforms.data(), matrices.data(), count); }) << std::endl;
+        std::cout << "\t\tcompose TRS -> 3x4: " << nsPerItem([&] { composeTransforms3x4(transforms.data(), affine.data(), count); }) << std::endl;
+        std::cout << "\t\tmat4 multiply: " << nsPerItem([&] { multiplyMatrices(lhs.data(), rhs.data(), matrices.data(), count); }) << std::endl;
+        std::cout << "\t\tmat4 premultiply: " << nsPerItem([&] { premultiplyMatrices(lhs[0], rhs.data(), matrices.data(), count); }) << std::endl;
+        std::cout << "\t\tAABB transform: " << nsPerItem([&] { transformAABBs(lhs.data(), inputBoxes.data(), boxes.data(), count); }) << std::endl;
+        std::cout << "\t\tsphere vs 6 planes: " << nsPerItem([&] { testSpheres(spheres.data(), count, planes, 6, visible.data()); }) << std::endl;
+    }
+
+    setSimdLevel(previous);
+}
+#endif
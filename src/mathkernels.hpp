@@ -0,0 +1,65 @@
+#pragma once
+
+#include "libs.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+namespace ASHMath {
+    struct Transform {
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+
+    // row-major 3x4 affine matrix, same layout as VkTransformMatrixKHR
+    struct Mat3x4 {
+        float m[3][4];
+    };
+
+    struct AABB {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    enum class simdLevels {
+        SCALAR,
+        SSE41,
+        AVX2
+    };
+
+    // highest level the CPU supports, detected once through CPUID
+    simdLevels detectSimdLevel();
+
+    // level used by the batch kernels, defaults to the detected one
+    simdLevels getSimdLevel();
+
+    // requests above the detected level are clamped to it, safe to call while job threads run kernels
+    void setSimdLevel(simdLevels level);
+
+    std::string simdLevelName(simdLevels level);
+
+    // out[i] = translate(position) * mat4_cast(rotation) * scale(scale)
+    void composeTransforms(const Transform* transforms, glm::mat4* out, size_t count);
+    void composeTransforms3x4(const Transform* transforms, Mat3x4* out, size_t count);
+
+    // out[i] = lhs[i] * rhs[i], out may alias either input
+    void multiplyMatrices(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, size_t count);
+
+    // out[i] = lhs * rhs[i], out may alias rhs
+    void premultiplyMatrices(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, size_t count);
+
+    // world space bounds of each box under its matrix (Arvo's method)
+    void transformAABBs(const glm::mat4* matrices, const AABB* boxes, AABB* out, size_t count);
+
+    // spheres are (center, radius), planes are (normal, distance) facing inwards
+    // writes 1 to visible[i] if sphere i is on the positive side of every plane, returns the visible count
+    size_t testSpheres(const glm::vec4* spheres, size_t count, const glm::vec4* planes, size_t planeCount, uint8_t* visible);
+
+    // normalized planes of the clip volume of a Vulkan style (0 to 1 depth) projection,
+    // ordered left, right, bottom, top, near, far
+    void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+    #ifdef BENCHMARK
+    void benchmarkKernels();
+    #endif
+}
@@ -1,5 +1,4 @@
 #include "memory.hpp"
-#include "onetimecommands.hpp"
 
 Buffer ASHUtil::createBuffer(BufferInput input) {
     vk::BufferCreateInfo bufferInfo{};
@@ -42,14 +41,10 @@ void ASHUtil::allocateBufferMemory(Buffer& buffer, const BufferInput& input) {
     input.device.bindBufferMemory(buffer.buffer, buffer.memory, 0);
 }
 
-void ASHUtil::copyBuffer(Buffer& src, Buffer& dst, vk::DeviceSize size, vk::Queue queue, vk::CommandBuffer commandBuffer) {
-    startJob(commandBuffer);
-
+void ASHUtil::copyBuffer(Buffer& src, Buffer& dst, vk::DeviceSize size, vk::CommandBuffer commandBuffer) {
     vk::BufferCopy copyRegion{};
     copyRegion.srcOffset = 0;
     copyRegion.dstOffset = 0;
     copyRegion.size = size;
     commandBuffer.copyBuffer(src.buffer, dst.buffer, 1, &copyRegion);
-
-    endJob(commandBuffer, queue);
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "meshwrapper.hpp"
 
+#include <limits>
+
 MeshWrapper::MeshWrapper() {
     m_indexOffset = 0;
 }
@@ -13,6 +15,20 @@ void MeshWrapper::consume(meshTypes type, std::vector<float>& vertices, std::vec
     m_firstIndices.insert(std::make_pair(type, lastIndex));
     m_indexCounts.insert(std::make_pair(type, indexCount));
 
+    // object space bounds for culling, positions are the first 3 of every 8 floats
+    ASHMath::AABB bounds;
+    bounds.min = glm::vec3(std::numeric_limits<float>::max());
+    bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+    std::vector<glm::vec3>& positions = m_positions[type];
+    for (size_t i = 0; i + 2 < vertices.size(); i += 8) {
+        glm::vec3 position = glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]);
+        bounds.min = glm::min(bounds.min, position);
+        bounds.max = glm::max(bounds.max, position);
+        positions.push_back(position);
+    }
+    m_bounds.insert(std::make_pair(type, bounds));
+    m_localIndices.insert(std::make_pair(type, indices));
+
     for (float attribute : vertices) {
         m_vertexLump.push_back(attribute);
     }
@@ -26,6 +42,9 @@ void MeshWrapper::consume(meshTypes type, std::vector<float>& vertices, std::vec
 
 void MeshWrapper::finalize(FinalizationChunk chunk) {
     m_device = chunk.device;
+    // both buffers go up in one job on the transfer queue
+    vk::CommandBuffer commandBuffer = chunk.transfer->begin();
+
     // Vertex buffer
     BufferInput input;
     input.device = m_device;
@@ -44,10 +63,10 @@ void MeshWrapper::finalize(FinalizationChunk chunk) {
     input.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
     m_vertexBuffer = ASHUtil::createBuffer(input);
 
-    ASHUtil::copyBuffer(stagingBuffer, m_vertexBuffer, input.size, chunk.queue, chunk.commandBuffer);
+    ASHUtil::copyBuffer(stagingBuffer, m_vertexBuffer, input.size, commandBuffer);
+    chunk.transfer->releaseBuffer(m_vertexBuffer.buffer, vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eVertexAttributeRead);
 
-    m_device.destroyBuffer(stagingBuffer.buffer);
-    m_device.freeMemory(stagingBuffer.memory);
+    Buffer vertexStaging = stagingBuffer;
 
     // Index buffer
     input.size = sizeof(m_indexLump[0]) * m_indexLump.size();
@@ -64,10 +83,18 @@ void MeshWrapper::finalize(FinalizationChunk chunk) {
     input.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
     m_indexBuffer = ASHUtil::createBuffer(input);
 
-    ASHUtil::copyBuffer(stagingBuffer, m_indexBuffer, input.size, chunk.queue, chunk.commandBuffer);
+    ASHUtil::copyBuffer(stagingBuffer, m_indexBuffer, input.size, commandBuffer);
+    chunk.transfer->releaseBuffer(m_indexBuffer.buffer, vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eIndexRead);
+
+    uint64_t uploaded = chunk.transfer->submit();
 
-    m_device.destroyBuffer(stagingBuffer.buffer);
-    m_device.freeMemory(stagingBuffer.memory);
+    vk::Device device = m_device;
+    chunk.transfer->getTimeline().destroyAfter(uploaded, [device, vertexStaging, stagingBuffer]() {
+        device.destroyBuffer(vertexStaging.buffer);
+        device.freeMemory(vertexStaging.memory);
+        device.destroyBuffer(stagingBuffer.buffer);
+        device.freeMemory(stagingBuffer.memory);
+    });
 
     m_indexLump.clear();
 
@@ -2,12 +2,13 @@
 
 #include "libs.hpp"
 #include "memory.hpp"
+#include "transfer.hpp"
+#include "mathkernels.hpp"
 
 struct FinalizationChunk {
     vk::Device device;
     vk::PhysicalDevice physicalDevice;
-    vk::Queue queue;
-    vk::CommandBuffer commandBuffer;
+    ASHUtil::TransferQueue* transfer;
 };
 
 class MeshWrapper {
@@ -19,6 +20,11 @@ class MeshWrapper {
         Buffer m_vertexBuffer, m_indexBuffer;
         std::unordered_map<meshTypes, int> m_firstIndices;
         std::unordered_map<meshTypes, int> m_indexCounts;
+        std::unordered_map<meshTypes, ASHMath::AABB> m_bounds;
+
+        // CPU copies for software occlusion, indices are local to the mesh
+        std::unordered_map<meshTypes, std::vector<glm::vec3>> m_positions;
+        std::unordered_map<meshTypes, std::vector<uint32_t>> m_localIndices;
 
     private:
         vk::Device m_device;
@@ -0,0 +1,448 @@
+#include "occlusion.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ASH_OCCLUSION_X86
+#include <immintrin.h>
+
+#define ASH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+using ASHUtil::OcclusionTriangle;
+using ASHUtil::occlusionWidth;
+using ASHUtil::occlusionHeight;
+using ASHUtil::occlusionTileWidth;
+using ASHUtil::occlusionTileHeight;
+
+namespace {
+    using Clock = std::chrono::high_resolution_clock;
+
+    constexpr int tilesX = occlusionWidth / occlusionTileWidth;
+    constexpr int tilesY = occlusionHeight / occlusionTileHeight;
+
+    double msSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // triangles reaching behind the near plane are dropped, that only makes culling less aggressive
+    // conservative triangles only cover pixels they cover entirely, with the farthest depth they reach inside them,
+    // so an occluder never hides more than it does at full resolution, otherwise pixel centers are sampled
+    bool setupTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, int width, int height, bool conservative, OcclusionTriangle& out) {
+        const glm::vec4* clip[3] = {&c0, &c1, &c2};
+        float x[3], y[3], z[3];
+
+        for (int i = 0; i < 3; ++i) {
+            if (clip[i]->w <= 0.0f || clip[i]->z < 0.0f) {
+                return false;
+            }
+
+            x[i] = (clip[i]->x / clip[i]->w * 0.5f + 0.5f) * width;
+            y[i] = (clip[i]->y / clip[i]->w * 0.5f + 0.5f) * height;
+            z[i] = clip[i]->z / clip[i]->w;
+        }
+
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (std::abs(area) < 1e-6f) {
+            return false;
+        }
+
+        // occluders are not backface culled, both windings end up with positive edge functions inside
+        if (area < 0.0f) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            area = -area;
+        }
+
+        for (int e = 0; e < 3; ++e) {
+            int a = e, b = (e + 1) % 3;
+            out.edgeA[e] = y[a] - y[b];
+            out.edgeB[e] = x[b] - x[a];
+            out.edgeC[e] = -(out.edgeA[e] * x[a] + out.edgeB[e] * y[a]);
+        }
+
+        out.depthDx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        out.depthDy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        out.depthC = z[0] - out.depthDx * x[0] - out.depthDy * y[0];
+
+        // the corner of the pixel where each edge function is smallest and the depth plane largest
+        for (int e = 0; e < 3; ++e) {
+            out.edgeC[e] += conservative ? std::min(out.edgeA[e], 0.0f) + std::min(out.edgeB[e], 0.0f) : 0.5f * (out.edgeA[e] + out.edgeB[e]);
+        }
+        out.depthC += conservative ? std::max(out.depthDx, 0.0f) + std::max(out.depthDy, 0.0f) : 0.5f * (out.depthDx + out.depthDy);
+        out.maxDepth = conservative ? std::max({z[0], z[1], z[2]}) : 1.0f;
+
+        out.minX = std::max(0, static_cast<int>(std::floor(std::min({x[0], x[1], x[2]}))));
+        out.maxX = std::min(width - 1, static_cast<int>(std::floor(std::max({x[0], x[1], x[2]}))));
+        out.minY = std::max(0, static_cast<int>(std::floor(std::min({y[0], y[1], y[2]}))));
+        out.maxY = std::min(height - 1, static_cast<int>(std::floor(std::max({y[0], y[1], y[2]}))));
+
+        return out.minX <= out.maxX && out.minY <= out.maxY;
+    }
+
+    // pixel rectangle and closest depth of a world space box, false if it can't be tested and has to be kept
+    bool projectBounds(const glm::mat4& viewProjection, const ASHMath::AABB& box, int width, int height, int rect[4], float& nearest) {
+        float minX = std::numeric_limits<float>::max(), minY = minX;
+        float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+        nearest = 1.0f;
+
+        for (int i = 0; i < 8; ++i) {
+            glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+
+            if (clip.w <= 0.0f || clip.z < 0.0f) {
+                return false;
+            }
+
+            float sx = (clip.x / clip.w * 0.5f + 0.5f) * width;
+            float sy = (clip.y / clip.w * 0.5f + 0.5f) * height;
+            minX = std::min(minX, sx);
+            maxX = std::max(maxX, sx);
+            minY = std::min(minY, sy);
+            maxY = std::max(maxY, sy);
+            nearest = std::min(nearest, clip.z / clip.w);
+        }
+
+        // off screen boxes are left to the frustum test
+        if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height) {
+            return false;
+        }
+
+        rect[0] = std::max(0, static_cast<int>(std::floor(minX)));
+        rect[1] = std::min(width - 1, static_cast<int>(std::floor(maxX)));
+        rect[2] = std::max(0, static_cast<int>(std::floor(minY)));
+        rect[3] = std::min(height - 1, static_cast<int>(std::floor(maxY)));
+        return true;
+    }
+
+    struct RasterKernels {
+        void (*rasterizeTriangle)(const OcclusionTriangle&, float*, int, int, int);
+        float (*tileMax)(const float*);
+        bool (*anyFarther)(const float*, int, int, float);
+    };
+
+    // Scalar
+
+    void rasterizeTriangleScalar(const OcclusionTriangle& t, float* depth, int width, int firstRow, int lastRow) {
+        int rowBegin = std::max(t.minY, firstRow);
+        int rowEnd = std::min(t.maxY + 1, lastRow);
+
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            float py = static_cast<float>(y);
+            for (int x = t.minX; x <= t.maxX; ++x) {
+                float px = static_cast<float>(x);
+
+                bool inside = true;
+                for (int e = 0; e < 3; ++e) {
+                    inside = inside && t.edgeA[e] * px + t.edgeB[e] * py + t.edgeC[e] > 0.0f;
+                }
+
+                if (inside) {
+                    float z = std::min(t.depthC + t.depthDx * px + t.depthDy * py, t.maxDepth);
+                    float& stored = depth[y * width + x];
+                    stored = std::min(stored, z);
+                }
+            }
+        }
+    }
+
+    // tile points at the top left pixel of an 8x4 block in the full buffer
+    float tileMaxScalar(const float* tile) {
+        float farthest = 0.0f;
+        for (int y = 0; y < occlusionTileHeight; ++y) {
+            for (int x = 0; x < occlusionTileWidth; ++x) {
+                farthest = std::max(farthest, tile[y * occlusionWidth + x]);
+            }
+        }
+        return farthest;
+    }
+
+    // row points at the first pixel of a tile row, checks pixels first to last of it
+    bool anyFartherScalar(const float* row, int first, int last, float depth) {
+        for (int x = first; x <= last; ++x) {
+            if (row[x] >= depth) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // AVX2
+
+    #ifdef ASH_OCCLUSION_X86
+
+    ASH_TARGET_AVX2 void rasterizeTriangleAVX(const OcclusionTriangle& t, float* depth, int width, int firstRow, int lastRow) {
+        const __m256 laneOffsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 maxDepth = _mm256_set1_ps(t.maxDepth);
+        const __m256 a0 = _mm256_set1_ps(t.edgeA[0]);
+        const __m256 a1 = _mm256_set1_ps(t.edgeA[1]);
+        const __m256 a2 = _mm256_set1_ps(t.edgeA[2]);
+        const __m256 dx = _mm256_set1_ps(t.depthDx);
+
+        int rowBegin = std::max(t.minY, firstRow);
+        int rowEnd = std::min(t.maxY + 1, lastRow);
+        int columnBegin = t.minX & ~(occlusionTileWidth - 1);
+
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            float py = static_cast<float>(y);
+            __m256 row0 = _mm256_set1_ps(t.edgeB[0] * py + t.edgeC[0]);
+            __m256 row1 = _mm256_set1_ps(t.edgeB[1] * py + t.edgeC[1]);
+            __m256 row2 = _mm256_set1_ps(t.edgeB[2] * py + t.edgeC[2]);
+            __m256 rowDepth = _mm256_set1_ps(t.depthC + t.depthDy * py);
+
+            float* line = depth + y * width;
+            for (int x = columnBegin; x <= t.maxX; x += 8) {
+                __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+
+                __m256 inside = _mm256_and_ps(
+                    _mm256_cmp_ps(_mm256_fmadd_ps(a0, px, row0), zero, _CMP_GT_OQ),
+                    _mm256_and_ps(
+                        _mm256_cmp_ps(_mm256_fmadd_ps(a1, px, row1), zero, _CMP_GT_OQ),
+                        _mm256_cmp_ps(_mm256_fmadd_ps(a2, px, row2), zero, _CMP_GT_OQ)
+                    )
+                );
+
+                if (_mm256_movemask_ps(inside) == 0) {
+                    continue;
+                }
+
+                __m256 z = _mm256_min_ps(_mm256_fmadd_ps(dx, px, rowDepth), maxDepth);
+                __m256 stored = _mm256_loadu_ps(line + x);
+                _mm256_storeu_ps(line + x, _mm256_blendv_ps(stored, _mm256_min_ps(stored, z), inside));
+            }
+        }
+    }
+
+    ASH_TARGET_AVX2 float tileMaxAVX(const float* tile) {
+        __m256 farthest = _mm256_max_ps(
+            _mm256_max_ps(_mm256_loadu_ps(tile), _mm256_loadu_ps(tile + occlusionWidth)),
+            _mm256_max_ps(_mm256_loadu_ps(tile + 2 * occlusionWidth), _mm256_loadu_ps(tile + 3 * occlusionWidth))
+        );
+
+        __m128 half = _mm_max_ps(_mm256_castps256_ps128(farthest), _mm256_extractf128_ps(farthest, 1));
+        half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+        return _mm_cvtss_f32(half);
+    }
+
+    ASH_TARGET_AVX2 bool anyFartherAVX(const float* row, int first, int last, float depth) {
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i inRange = _mm256_and_si256(
+            _mm256_cmpgt_epi32(lanes, _mm256_set1_epi32(first - 1)),
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(last + 1), lanes)
+        );
+
+        __m256 farther = _mm256_cmp_ps(_mm256_loadu_ps(row), _mm256_set1_ps(depth), _CMP_GE_OQ);
+        return _mm256_movemask_ps(_mm256_and_ps(farther, _mm256_castsi256_ps(inRange))) != 0;
+    }
+
+    #endif
+
+    // SSE 4.1 has no gain over scalar here, only AVX2 gets its own kernels
+    RasterKernels selectKernels() {
+        #ifdef ASH_OCCLUSION_X86
+        if (ASHMath::getSimdLevel() == ASHMath::simdLevels::AVX2) {
+            return {rasterizeTriangleAVX, tileMaxAVX, anyFartherAVX};
+        }
+        #endif
+        return {rasterizeTriangleScalar, tileMaxScalar, anyFartherScalar};
+    }
+}
+
+ASHUtil::OcclusionRasterizer::OcclusionRasterizer() {
+    m_depth.assign(occlusionWidth * occlusionHeight, 1.0f);
+    m_tileMax.assign(tilesX * tilesY, 1.0f);
+}
+
+void ASHUtil::OcclusionRasterizer::begin(const glm::mat4& viewProjection) {
+    m_viewProjection = viewProjection;
+    m_triangles.clear();
+    m_metrics = OcclusionMetrics();
+
+    #ifdef BENCHMARK
+    m_clipVertices.clear();
+    #endif
+}
+
+void ASHUtil::OcclusionRasterizer::addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4* matrices, size_t count) {
+    m_clipPositions.resize(positions.size());
+
+    for (size_t i = 0; i < count; ++i) {
+        glm::mat4 modelViewProjection = m_viewProjection * matrices[i];
+        for (size_t v = 0; v < positions.size(); ++v) {
+            m_clipPositions[v] = modelViewProjection * glm::vec4(positions[v], 1.0f);
+        }
+
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            const glm::vec4& c0 = m_clipPositions[indices[t]];
+            const glm::vec4& c1 = m_clipPositions[indices[t + 1]];
+            const glm::vec4& c2 = m_clipPositions[indices[t + 2]];
+
+            OcclusionTriangle triangle;
+            if (setupTriangle(c0, c1, c2, occlusionWidth, occlusionHeight, true, triangle)) {
+                m_triangles.push_back(triangle);
+            }
+            ++m_metrics.occluderTriangles;
+
+            #ifdef BENCHMARK
+            m_clipVertices.insert(m_clipVertices.end(), {c0, c1, c2});
+            #endif
+        }
+    }
+}
+
+void ASHUtil::OcclusionRasterizer::rasterize(JobSystem& jobs) {
+    Clock::time_point start = Clock::now();
+
+    // bands never share a row, so the workers write disjoint parts of the buffer
+    jobs.parallelFor(tilesY, 2, [this](size_t begin, size_t end) {
+        rasterizeBand(static_cast<int>(begin) * occlusionTileHeight, static_cast<int>(end) * occlusionTileHeight);
+    });
+
+    m_metrics.rasterizeMs = msSince(start);
+
+    #ifdef BENCHMARK
+    rasterizeReference();
+    #endif
+}
+
+void ASHUtil::OcclusionRasterizer::rasterizeBand(int firstRow, int lastRow) {
+    RasterKernels kernels = selectKernels();
+
+    std::fill(m_depth.begin() + firstRow * occlusionWidth, m_depth.begin() + lastRow * occlusionWidth, 1.0f);
+
+    for (const OcclusionTriangle& triangle : m_triangles) {
+        if (triangle.maxY < firstRow || triangle.minY >= lastRow) {
+            continue;
+        }
+        kernels.rasterizeTriangle(triangle, m_depth.data(), occlusionWidth, firstRow, lastRow);
+    }
+
+    for (int ty = firstRow / occlusionTileHeight; ty < lastRow / occlusionTileHeight; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            const float* tile = m_depth.data() + ty * occlusionTileHeight * occlusionWidth + tx * occlusionTileWidth;
+            m_tileMax[ty * tilesX + tx] = kernels.tileMax(tile);
+        }
+    }
+}
+
+uint32_t ASHUtil::OcclusionRasterizer::cull(glm::mat4* matrices, uint32_t count, const ASHMath::AABB& localBounds, JobSystem& jobs) {
+    Clock::time_point start = Clock::now();
+
+    m_localBounds.assign(count, localBounds);
+    m_worldBounds.resize(count);
+    m_visible.resize(count);
+
+    ASHMath::transformAABBs(matrices, m_localBounds.data(), m_worldBounds.data(), count);
+
+    jobs.parallelFor(count, 64, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            m_visible[i] = isVisible(m_worldBounds[i]) ? 1 : 0;
+        }
+    });
+
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (m_visible[i]) {
+            matrices[visibleCount++] = matrices[i];
+        }
+    }
+
+    m_metrics.testMs += msSince(start);
+    m_metrics.testedInstances += count;
+    m_metrics.occludedInstances += count - visibleCount;
+
+    #ifdef BENCHMARK
+    compareReference(count);
+    #endif
+
+    return visibleCount;
+}
+
+bool ASHUtil::OcclusionRasterizer::isVisible(const ASHMath::AABB& worldBounds) const {
+    int rect[4];
+    float nearest;
+    if (!projectBounds(m_viewProjection, worldBounds, occlusionWidth, occlusionHeight, rect, nearest)) {
+        return true;
+    }
+
+    RasterKernels kernels = selectKernels();
+
+    for (int ty = rect[2] / occlusionTileHeight; ty <= rect[3] / occlusionTileHeight; ++ty) {
+        for (int tx = rect[0] / occlusionTileWidth; tx <= rect[1] / occlusionTileWidth; ++tx) {
+            // everything in the tile is closer than the box
+            if (m_tileMax[ty * tilesX + tx] < nearest) {
+                continue;
+            }
+
+            int tileX = tx * occlusionTileWidth;
+            int first = std::max(rect[0], tileX) - tileX;
+            int last = std::min(rect[1], tileX + occlusionTileWidth - 1) - tileX;
+            int rowBegin = std::max(rect[2], ty * occlusionTileHeight);
+            int rowEnd = std::min(rect[3], ty * occlusionTileHeight + occlusionTileHeight - 1);
+
+            for (int y = rowBegin; y <= rowEnd; ++y) {
+                if (kernels.anyFarther(m_depth.data() + y * occlusionWidth + tileX, first, last, nearest)) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+const ASHUtil::OcclusionMetrics& ASHUtil::OcclusionRasterizer::getMetrics() const {
+    return m_metrics;
+}
+
+#ifdef BENCHMARK
+namespace {
+    constexpr int referenceWidth = occlusionWidth * 4;
+    constexpr int referenceHeight = occlusionHeight * 4;
+}
+
+void ASHUtil::OcclusionRasterizer::rasterizeReference() {
+    Clock::time_point start = Clock::now();
+
+    m_referenceDepth.assign(referenceWidth * referenceHeight, 1.0f);
+
+    for (size_t v = 0; v + 2 < m_clipVertices.size(); v += 3) {
+        OcclusionTriangle triangle;
+        if (setupTriangle(m_clipVertices[v], m_clipVertices[v + 1], m_clipVertices[v + 2], referenceWidth, referenceHeight, false, triangle)) {
+            rasterizeTriangleScalar(triangle, m_referenceDepth.data(), referenceWidth, 0, referenceHeight);
+        }
+    }
+
+    m_metrics.referenceMs += msSince(start);
+}
+
+void ASHUtil::OcclusionRasterizer::compareReference(size_t count) {
+    Clock::time_point start = Clock::now();
+
+    for (size_t i = 0; i < count; ++i) {
+        bool visible = true;
+
+        int rect[4];
+        float nearest;
+        if (projectBounds(m_viewProjection, m_worldBounds[i], referenceWidth, referenceHeight, rect, nearest)) {
+            visible = false;
+            for (int y = rect[2]; y <= rect[3] && !visible; ++y) {
+                visible = anyFartherScalar(m_referenceDepth.data() + y * referenceWidth, rect[0], rect[1], nearest);
+            }
+        }
+
+        if (visible && !m_visible[i]) {
+            ++m_metrics.falseOccluded;
+        } else if (!visible && m_visible[i]) {
+            ++m_metrics.missedOccluded;
+        }
+    }
+
+    m_metrics.referenceMs += msSince(start);
+}
+#endif
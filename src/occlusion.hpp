@@ -0,0 +1,81 @@
+#pragma once
+
+#include "libs.hpp"
+#include "mathkernels.hpp"
+#include "jobs.hpp"
+
+namespace ASHUtil {
+    // resolution of the software depth buffer, a tile row is one AVX2 register wide
+    constexpr int occlusionWidth = 256;
+    constexpr int occlusionHeight = 128;
+    constexpr int occlusionTileWidth = 8;
+    constexpr int occlusionTileHeight = 4;
+
+    // edge functions are positive inside, depth is a plane over screen space, both are evaluated at a pixel's
+    // top left corner with the sample point folded into edgeC and depthC
+    struct OcclusionTriangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthC, depthDx, depthDy;
+        float maxDepth; // farthest vertex, the plane is clamped to it
+        int minX, maxX, minY, maxY;
+    };
+
+    // for one frame, reset by begin()
+    struct OcclusionMetrics {
+        uint32_t occluderTriangles = 0;
+        uint32_t testedInstances = 0;
+        uint32_t occludedInstances = 0;
+        double rasterizeMs = 0.0;
+        double testMs = 0.0;
+
+        // only filled when BENCHMARK is defined, against a scalar rasterizer at 4x the resolution without tiles or threads
+        double referenceMs = 0.0;
+        uint32_t falseOccluded = 0;  // culled here but visible in the reference, these pop
+        uint32_t missedOccluded = 0; // occluded in the reference but kept here
+    };
+
+    // CPU occlusion culling: occluders are rasterized into a low resolution depth buffer with a per tile
+    // farthest depth, instance bounds are rejected when every pixel they cover holds something closer
+    class OcclusionRasterizer {
+        public:
+            OcclusionRasterizer();
+
+            // clears the depth buffer and the queued occluders
+            void begin(const glm::mat4& viewProjection);
+
+            // queues every triangle of the mesh once per instance matrix
+            void addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4* matrices, size_t count);
+
+            // rasterizes the queued occluders, bands of tile rows are spread over the job system
+            void rasterize(JobSystem& jobs);
+
+            // compacts the matrices whose bounds are not hidden behind the occluders to the front, returns how many are left
+            uint32_t cull(glm::mat4* matrices, uint32_t count, const ASHMath::AABB& localBounds, JobSystem& jobs);
+
+            const OcclusionMetrics& getMetrics() const;
+
+        private:
+            glm::mat4 m_viewProjection;
+            std::vector<glm::vec4> m_clipPositions; // scratch for one occluder instance
+            std::vector<OcclusionTriangle> m_triangles;
+
+            std::vector<float> m_depth;   // row major, closest occluder depth per pixel
+            std::vector<float> m_tileMax; // farthest depth in each tile
+
+            std::vector<ASHMath::AABB> m_localBounds, m_worldBounds;
+            std::vector<uint8_t> m_visible;
+
+            OcclusionMetrics m_metrics;
+
+            void rasterizeBand(int firstRow, int lastRow);
+
+            bool isVisible(const ASHMath::AABB& worldBounds) const;
+
+            #ifdef BENCHMARK
+            std::vector<glm::vec4> m_clipVertices; // three per occluder triangle, set up again at the reference resolution
+            std::vector<float> m_referenceDepth;
+            void rasterizeReference();
+            void compareReference(size_t count);
+            #endif
+    };
+}
@@ -1,6 +1,13 @@
 #include "onetimecommands.hpp"
 
-void ASHUtil::startJob(vk::CommandBuffer commandBuffer) {
+namespace {
+    // value of the last job recorded into each command buffer
+    std::unordered_map<VkCommandBuffer, uint64_t> jobValues;
+}
+
+void ASHUtil::startJob(vk::CommandBuffer commandBuffer, Timeline& timeline) {
+    timeline.wait(jobValues[commandBuffer]);
+
     commandBuffer.reset();
 
 
@@ -10,12 +17,10 @@ void ASHUtil::startJob(vk::CommandBuffer commandBuffer) {
     commandBuffer.begin(beginInfo);
 }
 
-void ASHUtil::endJob(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+uint64_t ASHUtil::endJob(vk::CommandBuffer commandBuffer, vk::Queue queue, Timeline& timeline) {
     commandBuffer.end();
 
-    vk::SubmitInfo submitInfo{};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    queue.submit(1, &submitInfo, nullptr);
-    queue.waitIdle();
-}
\ No newline at end of file
+    uint64_t value = timeline.submit(queue, commandBuffer);
+    jobValues[commandBuffer] = value;
+    return value;
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "libs.hpp"
+#include "timeline.hpp"
 
 namespace ASHUtil {
-    void startJob(vk::CommandBuffer commandBuffer);
+    // waits for the last job recorded into commandBuffer before resetting it
+    void startJob(vk::CommandBuffer commandBuffer, Timeline& timeline);
 
-    void endJob(vk::CommandBuffer commandBuffer, vk::Queue queue);
-}
\ No newline at end of file
+    // submits without waiting, returns the timeline value to wait on or to defer freeing staging memory to
+    uint64_t endJob(vk::CommandBuffer commandBuffer, vk::Queue queue, Timeline& timeline);
+}
@@ -4,15 +4,29 @@
 #include "shaders.hpp"
 #include "renderstructs.hpp"
 #include "mesh.hpp"
+#include "pipelineregistry.hpp"
 
 namespace ASHInit {
+    // how a graphics pipeline treats depth
+    enum class depthModes {
+        WRITE,   // tests with eLess and writes, the only pass over the geometry
+        PREPASS, // the same with color writes masked off, position is the only vertex input
+        EQUAL    // tests with eLessOrEqual against what a pre-pass wrote, writes nothing
+    };
+
     struct GraphicsPipelineInputBundle {
         vk::Device device;
-        std::string vertFilePath;
-        std::string fragFilePath;
-        vk::Extent2D swapchainExtent;
+        std::string vertShader, fragShader; // names of the compiled shaders, e.g. shader.vert.spv, no fragment stage if fragShader is empty
+        std::string shaderDirectory; // may be empty, compiled shaders found here replace the embedded ones
+        std::vector<uint32_t> vertSpecialization, fragSpecialization; // specialization constants, constant_id i takes entry i
         vk::Format swapchainImageFormat, depthFormat;
         std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+        uint32_t pushConstantSize = 0; // vertex stage, 0 for none
+        vk::PipelineCache pipelineCache; // may be null
+        vk::PipelineLayout layout; // shared with other variants, created along with the pipeline when null
+        vk::RenderPass renderPass; // likewise
+        bool present = true; // false for offscreen targets, which are left ready to be copied from instead
+        depthModes depthMode = depthModes::WRITE;
     };
 
     struct GraphicsPipelineOutputBundle {
@@ -20,6 +34,30 @@ namespace ASHInit {
         vk::PipelineLayout layout;
         vk::RenderPass renderPass;
     };
+
+    struct ComputePipelineInputBundle {
+        vk::Device device;
+        std::string shader;
+        std::string shaderDirectory;
+        std::vector<uint32_t> specialization; // likewise
+        std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+        uint32_t pushConstantSize;
+        vk::PipelineCache pipelineCache; // may be null
+        vk::PipelineLayout layout; // created along with the pipeline when null
+    };
+
+    struct ComputePipelineOutputBundle {
+        vk::Pipeline pipeline;
+        vk::PipelineLayout layout;
+    };
+
+    // how a render pass treats attachments when the frame is split over several passes
+    enum class renderPassPhases {
+        SINGLE, // clears and presents, depth is discarded
+        FIRST,  // clears and keeps both attachments for a later pass
+        LAST    // continues from an earlier pass and presents
+    };
+
     // Declarations
     vk::PipelineVertexInputStateCreateInfo createVertexInputInfo(
 		const vk::VertexInputBindingDescription& bindingDescription,
@@ -28,17 +66,25 @@ namespace ASHInit {
 
 	vk::PipelineInputAssemblyStateCreateInfo createInputAssemblyInfo();
     
+    // entries is filled with one 32 bit entry per constant and has to outlive the returned info
+    vk::SpecializationInfo createSpecializationInfo(
+        const std::vector<uint32_t>& constants, std::vector<vk::SpecializationMapEntry>& entries
+    );
+
+    // specialization may be null, the driver compiles the variant it describes with the dead paths removed
     vk::PipelineShaderStageCreateInfo createShaderInfo(
-		const vk::ShaderModule& shaderModule, const vk::ShaderStageFlagBits& stage
+		const vk::ShaderModule& shaderModule, const vk::ShaderStageFlagBits& stage,
+        const vk::SpecializationInfo* specialization = nullptr
     );
 
-    vk::Viewport createViewport(const GraphicsPipelineInputBundle& input);
+    // viewport and scissor are dynamic, so these are set while recording rather than baked into the pipeline
+    vk::Viewport createViewport(vk::Extent2D extent);
 
-    vk::Rect2D createScissor(const GraphicsPipelineInputBundle& input);
+    vk::Rect2D createScissor(vk::Extent2D extent);
 
-    vk::PipelineViewportStateCreateInfo createViewportStateInfo(
-        const vk::Viewport& viewport, const vk::Rect2D& scissor
-    );
+    vk::PipelineViewportStateCreateInfo createViewportStateInfo();
+
+    vk::PipelineDynamicStateCreateInfo createDynamicStateInfo(const std::vector<vk::DynamicState>& dynamicStates);
 
     vk::PipelineRasterizationStateCreateInfo createRasterizerInfo();
 
@@ -50,22 +96,28 @@ namespace ASHInit {
 		const vk::PipelineColorBlendAttachmentState& colorBlendAttachment
     );
 
-    vk::PipelineLayout createPipelineLayout(vk::Device device, std::vector<vk::DescriptorSetLayout> descriptorSetLayouts);
+    // pushConstantRanges may be empty
+    vk::PipelineLayout createPipelineLayout(
+        vk::Device device, std::vector<vk::DescriptorSetLayout> descriptorSetLayouts,
+        const std::vector<vk::PushConstantRange>& pushConstantRanges = {}
+    );
 
-    vk::PushConstantRange createPushConstantInfo();
+    // one range from offset 0, size has to be a multiple of 4
+    vk::PushConstantRange createPushConstantInfo(vk::ShaderStageFlags stages, uint32_t size);
 
     vk::RenderPass createRenderPass(
-        vk::Device device, const vk::Format swapchainImageFormat, const vk::Format depthFormat
+        vk::Device device, const vk::Format swapchainImageFormat, const vk::Format depthFormat,
+        renderPassPhases phase = renderPassPhases::SINGLE, bool present = true
     );
 
     vk::AttachmentDescription createColorAttachment(
-        const vk::Format& swapchainImageFormat
+        const vk::Format& swapchainImageFormat, renderPassPhases phase, bool present
     );
 
     vk::AttachmentReference createColorAttachmentRef();
 
     vk::AttachmentDescription createDepthAttachment(
-        const vk::Format& depthFormat
+        const vk::Format& depthFormat, renderPassPhases phase
     );
 
     vk::AttachmentReference createDepthAttachmentRef();
@@ -79,6 +131,38 @@ namespace ASHInit {
         const vk::SubpassDescription& subpass
     );
 
+    // registry keys, everything that ends up in the pipeline besides the pipeline cache is hashed
+    uint64_t hashGraphicsPipelineState(const GraphicsPipelineInputBundle& spec) {
+        uint64_t hash = ASHUtil::hashState(ASHUtil::stateHashSeed, spec.vertShader.data(), spec.vertShader.size());
+        hash = ASHUtil::hashState(hash, spec.fragShader.data(), spec.fragShader.size());
+        hash = ASHUtil::hashState(hash, spec.shaderDirectory.data(), spec.shaderDirectory.size());
+        // the counts keep {a}, {} from colliding with {}, {a}
+        uint64_t vertCount = spec.vertSpecialization.size(), fragCount = spec.fragSpecialization.size();
+        hash = ASHUtil::hashState(hash, &vertCount, sizeof(vertCount));
+        hash = ASHUtil::hashState(hash, spec.vertSpecialization.data(), vertCount * sizeof(uint32_t));
+        hash = ASHUtil::hashState(hash, &fragCount, sizeof(fragCount));
+        hash = ASHUtil::hashState(hash, spec.fragSpecialization.data(), fragCount * sizeof(uint32_t));
+        hash = ASHUtil::hashState(hash, &spec.swapchainImageFormat, sizeof(spec.swapchainImageFormat));
+        hash = ASHUtil::hashState(hash, &spec.depthFormat, sizeof(spec.depthFormat));
+        hash = ASHUtil::hashState(hash, spec.descriptorSetLayouts.data(), spec.descriptorSetLayouts.size() * sizeof(vk::DescriptorSetLayout));
+        hash = ASHUtil::hashState(hash, &spec.pushConstantSize, sizeof(spec.pushConstantSize));
+        hash = ASHUtil::hashState(hash, &spec.layout, sizeof(spec.layout));
+        hash = ASHUtil::hashState(hash, &spec.renderPass, sizeof(spec.renderPass));
+        hash = ASHUtil::hashState(hash, &spec.present, sizeof(spec.present));
+        return ASHUtil::hashState(hash, &spec.depthMode, sizeof(spec.depthMode));
+    }
+
+    uint64_t hashComputePipelineState(const ComputePipelineInputBundle& spec) {
+        uint64_t hash = ASHUtil::hashState(ASHUtil::stateHashSeed, spec.shader.data(), spec.shader.size());
+        hash = ASHUtil::hashState(hash, spec.shaderDirectory.data(), spec.shaderDirectory.size());
+        uint64_t count = spec.specialization.size();
+        hash = ASHUtil::hashState(hash, &count, sizeof(count));
+        hash = ASHUtil::hashState(hash, spec.specialization.data(), count * sizeof(uint32_t));
+        hash = ASHUtil::hashState(hash, spec.descriptorSetLayouts.data(), spec.descriptorSetLayouts.size() * sizeof(vk::DescriptorSetLayout));
+        hash = ASHUtil::hashState(hash, &spec.pushConstantSize, sizeof(spec.pushConstantSize));
+        return ASHUtil::hashState(hash, &spec.layout, sizeof(spec.layout));
+    }
+
     // Main creation function
     GraphicsPipelineOutputBundle createGraphicsPipeline(GraphicsPipelineInputBundle spec) {
         vk::GraphicsPipelineCreateInfo pipelineInfo{};
@@ -89,6 +173,10 @@ namespace ASHInit {
         // Vertex Input
         vk::VertexInputBindingDescription bindingDescription = ASHModel::getPosColorBindingDescription();
         std::vector<vk::VertexInputAttributeDescription> attributeDescriptions = ASHModel::getPosColorAttributeDescriptions();
+        if (spec.depthMode == depthModes::PREPASS) {
+            // same vertex buffers, only the position is read
+            attributeDescriptions.resize(1);
+        }
         vk::PipelineVertexInputStateCreateInfo vertexInputInfo = createVertexInputInfo(bindingDescription, attributeDescriptions);
         pipelineInfo.pVertexInputState = &vertexInputInfo;
 
@@ -97,24 +185,33 @@ namespace ASHInit {
         pipelineInfo.pInputAssemblyState = &inputAssembly;
 
         // Vertex Shader
-        vk::ShaderModule vertShader = ASHUtil::createShaderModule(spec.vertFilePath, spec.device);
-        vk::PipelineShaderStageCreateInfo vertShaderInfo = createShaderInfo(vertShader, vk::ShaderStageFlagBits::eVertex);
+        vk::ShaderModule vertShader = ASHUtil::createShaderModule(spec.vertShader, spec.device, spec.shaderDirectory);
+        std::vector<vk::SpecializationMapEntry> vertEntries;
+        vk::SpecializationInfo vertSpecialization = createSpecializationInfo(spec.vertSpecialization, vertEntries);
+        vk::PipelineShaderStageCreateInfo vertShaderInfo = createShaderInfo(vertShader, vk::ShaderStageFlagBits::eVertex, spec.vertSpecialization.empty() ? nullptr : &vertSpecialization);
         shaderStages.push_back(vertShaderInfo);
 
-        // Viewport and Scissor
-        vk::Viewport viewport = createViewport(spec);
-        vk::Rect2D scissor = createScissor(spec);
-        vk::PipelineViewportStateCreateInfo viewportState = createViewportStateInfo(viewport, scissor);
+        // Viewport and Scissor, a resize doesn't have to rebuild the pipeline
+        vk::PipelineViewportStateCreateInfo viewportState = createViewportStateInfo();
         pipelineInfo.pViewportState = &viewportState;
 
+        std::vector<vk::DynamicState> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+        vk::PipelineDynamicStateCreateInfo dynamicState = createDynamicStateInfo(dynamicStates);
+        pipelineInfo.pDynamicState = &dynamicState;
+
         // Rasterizer
         vk::PipelineRasterizationStateCreateInfo rasterizer = createRasterizerInfo();
         pipelineInfo.pRasterizationState = &rasterizer;
 
         // Fragment Shader
-        vk::ShaderModule fragShader = ASHUtil::createShaderModule(spec.fragFilePath, spec.device);
-        vk::PipelineShaderStageCreateInfo fragShaderInfo = createShaderInfo(fragShader, vk::ShaderStageFlagBits::eFragment);
-        shaderStages.push_back(fragShaderInfo);
+        vk::ShaderModule fragShader;
+        std::vector<vk::SpecializationMapEntry> fragEntries;
+        vk::SpecializationInfo fragSpecialization = createSpecializationInfo(spec.fragSpecialization, fragEntries);
+        if (!spec.fragShader.empty()) {
+            fragShader = ASHUtil::createShaderModule(spec.fragShader, spec.device, spec.shaderDirectory);
+            vk::PipelineShaderStageCreateInfo fragShaderInfo = createShaderInfo(fragShader, vk::ShaderStageFlagBits::eFragment, spec.fragSpecialization.empty() ? nullptr : &fragSpecialization);
+            shaderStages.push_back(fragShaderInfo);
+        }
 
         pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
         pipelineInfo.pStages = shaderStages.data();
@@ -123,8 +220,9 @@ namespace ASHInit {
         vk::PipelineDepthStencilStateCreateInfo depthState;
         depthState.flags = vk::PipelineDepthStencilStateCreateFlags();
         depthState.depthTestEnable = VK_TRUE;
-        depthState.depthWriteEnable = VK_TRUE;
-        depthState.depthCompareOp = vk::CompareOp::eLess;
+        depthState.depthWriteEnable = spec.depthMode == depthModes::EQUAL ? VK_FALSE : VK_TRUE;
+        // the pre-pass left exactly the visible depth, only fragments at it pass
+        depthState.depthCompareOp = spec.depthMode == depthModes::EQUAL ? vk::CompareOp::eLessOrEqual : vk::CompareOp::eLess;
         depthState.depthBoundsTestEnable = VK_FALSE;
         depthState.stencilTestEnable = VK_FALSE;
         pipelineInfo.pDepthStencilState = &depthState;
@@ -135,15 +233,22 @@ namespace ASHInit {
 
         // Color Blending
         vk::PipelineColorBlendAttachmentState colorBlendAttachment = createColorBlendAttachmentState();
+        if (spec.depthMode == depthModes::PREPASS) {
+            colorBlendAttachment.colorWriteMask = vk::ColorComponentFlags();
+        }
         vk::PipelineColorBlendStateCreateInfo colorBlending = createColorBlendAttachmentStage(colorBlendAttachment);
         pipelineInfo.pColorBlendState = &colorBlending;
 
         // Pipeline Layout
-        vk::PipelineLayout pipelineLayout = createPipelineLayout(spec.device, spec.descriptorSetLayouts);
+        std::vector<vk::PushConstantRange> pushConstantRanges;
+        if (spec.pushConstantSize > 0) {
+            pushConstantRanges.push_back(createPushConstantInfo(vk::ShaderStageFlagBits::eVertex, spec.pushConstantSize));
+        }
+        vk::PipelineLayout pipelineLayout = spec.layout ? spec.layout : createPipelineLayout(spec.device, spec.descriptorSetLayouts, pushConstantRanges);
         pipelineInfo.layout = pipelineLayout;
 
         // Render Pass
-        vk::RenderPass renderPass = createRenderPass(spec.device, spec.swapchainImageFormat, spec.depthFormat);
+        vk::RenderPass renderPass = spec.renderPass ? spec.renderPass : createRenderPass(spec.device, spec.swapchainImageFormat, spec.depthFormat, renderPassPhases::SINGLE, spec.present);
         pipelineInfo.renderPass = renderPass;
         pipelineInfo.subpass = 0;
 
@@ -151,13 +256,15 @@ namespace ASHInit {
 
         vk::Pipeline pipeline;
         try {
-            pipeline = spec.device.createGraphicsPipeline(nullptr, pipelineInfo).value;
+            pipeline = spec.device.createGraphicsPipeline(spec.pipelineCache, pipelineInfo).value;
         } catch (vk::SystemError err) {
             throw std::runtime_error("Failed to create graphics pipeline");
         }
 
         spec.device.destroyShaderModule(vertShader);
-        spec.device.destroyShaderModule(fragShader);
+        if (fragShader) {
+            spec.device.destroyShaderModule(fragShader);
+        }
 
         GraphicsPipelineOutputBundle output{};
         output.pipeline = pipeline;
@@ -167,6 +274,47 @@ namespace ASHInit {
         return output;
     }
 
+    vk::PipelineLayout createComputePipelineLayout(const ComputePipelineInputBundle& spec) {
+        vk::PushConstantRange pushConstantRange = createPushConstantInfo(vk::ShaderStageFlagBits::eCompute, spec.pushConstantSize);
+
+        vk::PipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.flags = vk::PipelineLayoutCreateFlags();
+        layoutInfo.setLayoutCount = static_cast<uint32_t>(spec.descriptorSetLayouts.size());
+        layoutInfo.pSetLayouts = spec.descriptorSetLayouts.data();
+        layoutInfo.pushConstantRangeCount = spec.pushConstantSize > 0 ? 1 : 0;
+        layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        try {
+            return spec.device.createPipelineLayout(layoutInfo);
+        } catch (vk::SystemError err) {
+            throw std::runtime_error("Failed to create compute pipeline layout");
+        }
+    }
+
+    ComputePipelineOutputBundle createComputePipeline(ComputePipelineInputBundle spec) {
+        vk::ShaderModule shader = ASHUtil::createShaderModule(spec.shader, spec.device, spec.shaderDirectory);
+
+        ComputePipelineOutputBundle output{};
+        output.layout = spec.layout ? spec.layout : createComputePipelineLayout(spec);
+
+        vk::ComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.flags = vk::PipelineCreateFlags();
+        std::vector<vk::SpecializationMapEntry> entries;
+        vk::SpecializationInfo specialization = createSpecializationInfo(spec.specialization, entries);
+        pipelineInfo.stage = createShaderInfo(shader, vk::ShaderStageFlagBits::eCompute, spec.specialization.empty() ? nullptr : &specialization);
+        pipelineInfo.layout = output.layout;
+
+        try {
+            output.pipeline = spec.device.createComputePipeline(spec.pipelineCache, pipelineInfo).value;
+        } catch (vk::SystemError err) {
+            throw std::runtime_error("Failed to create compute pipeline");
+        }
+
+        spec.device.destroyShaderModule(shader);
+
+        return output;
+    }
+
     // Implementations
 
     vk::PipelineVertexInputStateCreateInfo createVertexInputInfo(
@@ -189,47 +337,71 @@ namespace ASHInit {
         return inputAssembly;
     }
 
+    vk::SpecializationInfo createSpecializationInfo(
+        const std::vector<uint32_t>& constants, std::vector<vk::SpecializationMapEntry>& entries
+    ) {
+        entries.clear();
+        for (uint32_t i = 0; i < constants.size(); ++i) {
+            entries.push_back(vk::SpecializationMapEntry(i, i * sizeof(uint32_t), sizeof(uint32_t)));
+        }
+
+        vk::SpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+        specializationInfo.pMapEntries = entries.data();
+        specializationInfo.dataSize = constants.size() * sizeof(uint32_t);
+        specializationInfo.pData = constants.data();
+        return specializationInfo;
+    }
+
     vk::PipelineShaderStageCreateInfo createShaderInfo(
-        const vk::ShaderModule& shaderModule, const vk::ShaderStageFlagBits& stage
+        const vk::ShaderModule& shaderModule, const vk::ShaderStageFlagBits& stage,
+        const vk::SpecializationInfo* specialization
     ) {
         vk::PipelineShaderStageCreateInfo shaderStage{};
         shaderStage.flags = vk::PipelineShaderStageCreateFlags();
         shaderStage.stage = stage;
         shaderStage.module = shaderModule;
         shaderStage.pName = "main";
+        shaderStage.pSpecializationInfo = specialization;
         return shaderStage;
     }
 
-    vk::Viewport createViewport(const GraphicsPipelineInputBundle& input) {
+    vk::Viewport createViewport(vk::Extent2D extent) {
         vk::Viewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
-        viewport.width = static_cast<float>(input.swapchainExtent.width);
-        viewport.height = static_cast<float>(input.swapchainExtent.height);
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
         return viewport;
     }
 
-    vk::Rect2D createScissor(const GraphicsPipelineInputBundle& input) {
+    vk::Rect2D createScissor(vk::Extent2D extent) {
         vk::Rect2D scissor{};
         scissor.offset = vk::Offset2D{0, 0};
-        scissor.extent = input.swapchainExtent;
+        scissor.extent = extent;
         return scissor;
     }
 
-    vk::PipelineViewportStateCreateInfo createViewportStateInfo(
-        const vk::Viewport& viewport, const vk::Rect2D& scissor
-    ) {
+    vk::PipelineViewportStateCreateInfo createViewportStateInfo() {
         vk::PipelineViewportStateCreateInfo viewportState{};
         viewportState.flags = vk::PipelineViewportStateCreateFlags();
         viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
+        viewportState.pViewports = nullptr;
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
+        viewportState.pScissors = nullptr;
         return viewportState;
     }
 
+    vk::PipelineDynamicStateCreateInfo createDynamicStateInfo(const std::vector<vk::DynamicState>& dynamicStates) {
+        vk::PipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.flags = vk::PipelineDynamicStateCreateFlags();
+        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+        dynamicState.pDynamicStates = dynamicStates.data();
+        return dynamicState;
+    }
+
     vk::PipelineRasterizationStateCreateInfo createRasterizerInfo() {
         vk::PipelineRasterizationStateCreateInfo rasterizer{};
         rasterizer.flags = vk::PipelineRasterizationStateCreateFlags();
@@ -274,14 +446,18 @@ namespace ASHInit {
         return colorBlending;
     }
 
-    vk::PipelineLayout createPipelineLayout(vk::Device device, std::vector<vk::DescriptorSetLayout> descriptorSetLayouts) {
+    vk::PipelineLayout createPipelineLayout(
+        vk::Device device, std::vector<vk::DescriptorSetLayout> descriptorSetLayouts,
+        const std::vector<vk::PushConstantRange>& pushConstantRanges
+    ) {
         vk::PipelineLayoutCreateInfo layoutInfo{};
         layoutInfo.flags = vk::PipelineLayoutCreateFlags();
 
         layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
         layoutInfo.pSetLayouts = descriptorSetLayouts.data();
 
-        layoutInfo.pushConstantRangeCount = 0;
+        layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        layoutInfo.pPushConstantRanges = pushConstantRanges.data();
 
         try {
             return device.createPipelineLayout(layoutInfo);
@@ -291,16 +467,25 @@ namespace ASHInit {
 
     }
 
+    vk::PushConstantRange createPushConstantInfo(vk::ShaderStageFlags stages, uint32_t size) {
+        vk::PushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = stages;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = size;
+        return pushConstantRange;
+    }
+
     vk::RenderPass createRenderPass(
-        vk::Device device, const vk::Format swapchainImageFormat, const vk::Format depthFormat
+        vk::Device device, const vk::Format swapchainImageFormat, const vk::Format depthFormat,
+        renderPassPhases phase, bool present
     ) {
         std::vector<vk::AttachmentDescription> attachments;
         std::vector<vk::AttachmentReference> attachmentRefs;
 
-        attachments.push_back(createColorAttachment(swapchainImageFormat));
+        attachments.push_back(createColorAttachment(swapchainImageFormat, phase, present));
         attachmentRefs.push_back(createColorAttachmentRef());
 
-        attachments.push_back(createDepthAttachment(depthFormat));
+        attachments.push_back(createDepthAttachment(depthFormat, phase));
         attachmentRefs.push_back(createDepthAttachmentRef());
 
         vk::SubpassDescription subpass = createSubpass(attachmentRefs);
@@ -317,18 +502,19 @@ namespace ASHInit {
     }
 
     vk::AttachmentDescription createColorAttachment(
-        const vk::Format& swapchainImageFormat
+        const vk::Format& swapchainImageFormat, renderPassPhases phase, bool present
     ) {
         vk::AttachmentDescription colorAttachment{};
         colorAttachment.flags = vk::AttachmentDescriptionFlags();
         colorAttachment.format = swapchainImageFormat;
         colorAttachment.samples = vk::SampleCountFlagBits::e1;
-        colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+        colorAttachment.loadOp = phase == renderPassPhases::LAST ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
         colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
         colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
         colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-        colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-        colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+        colorAttachment.initialLayout = phase == renderPassPhases::LAST ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eUndefined;
+        colorAttachment.finalLayout = phase == renderPassPhases::FIRST ? vk::ImageLayout::eColorAttachmentOptimal
+            : present ? vk::ImageLayout::ePresentSrcKHR : vk::ImageLayout::eTransferSrcOptimal;
         return colorAttachment;
     }
 
@@ -340,17 +526,18 @@ namespace ASHInit {
     }
 
     vk::AttachmentDescription createDepthAttachment(
-        const vk::Format& depthFormat
+        const vk::Format& depthFormat, renderPassPhases phase
     ) {
         vk::AttachmentDescription colorAttachment{};
         colorAttachment.flags = vk::AttachmentDescriptionFlags();
         colorAttachment.format = depthFormat;
         colorAttachment.samples = vk::SampleCountFlagBits::e1;
-        colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-        colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+        colorAttachment.loadOp = phase == renderPassPhases::LAST ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
+        // the depth pyramid is built from what the split passes store
+        colorAttachment.storeOp = phase == renderPassPhases::SINGLE ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
         colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
         colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-        colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
+        colorAttachment.initialLayout = phase == renderPassPhases::LAST ? vk::ImageLayout::eDepthStencilAttachmentOptimal : vk::ImageLayout::eUndefined;
         colorAttachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
         return colorAttachment;
     }
@@ -0,0 +1,150 @@
+#include "pipelinecache.hpp"
+#include "pipelineregistry.hpp"
+
+#include <filesystem>
+#include <cstring>
+
+namespace {
+    constexpr uint32_t cacheMagic = 0x48534150; // "PASH"
+    constexpr uint32_t cacheFormatVersion = 1;
+
+    // in front of the driver's own blob, whose header has no driver version and isn't checked until creation
+    struct CacheFileHeader {
+        uint32_t magic;
+        uint32_t formatVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    // catches a truncated or corrupted file
+    uint64_t hashData(const std::vector<uint8_t>& data) {
+        return ASHUtil::hashState(ASHUtil::stateHashSeed, data.data(), data.size());
+    }
+}
+
+ASHUtil::PipelineCache::PipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice, const std::string& path)
+    : m_device(device), m_properties(physicalDevice.getProperties()), m_path(path) {
+    std::vector<uint8_t> data = load();
+
+    vk::PipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.data();
+
+    try {
+        m_cache = m_device.createPipelineCache(cacheInfo);
+    } catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create pipeline cache");
+    }
+}
+
+ASHUtil::PipelineCache::~PipelineCache() {
+    save();
+    m_device.destroyPipelineCache(m_cache);
+}
+
+vk::PipelineCache ASHUtil::PipelineCache::get() const {
+    return m_cache;
+}
+
+bool ASHUtil::PipelineCache::isWarm() const {
+    return m_warm;
+}
+
+const std::string& ASHUtil::PipelineCache::getStatus() const {
+    return m_status;
+}
+
+std::vector<uint8_t> ASHUtil::PipelineCache::load() {
+    if (m_path.empty()) {
+        m_status = "not persisted";
+        return {};
+    }
+
+    std::ifstream file(m_path, std::ios::binary);
+    if (!file) {
+        m_status = "no cache file";
+        return {};
+    }
+
+    CacheFileHeader header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != cacheMagic || header.formatVersion != cacheFormatVersion) {
+        m_status = "unrecognized cache file";
+        return {};
+    }
+
+    if (header.vendorID != m_properties.vendorID || header.deviceID != m_properties.deviceID) {
+        m_status = "written for another device";
+        return {};
+    }
+    if (header.driverVersion != m_properties.driverVersion) {
+        m_status = "written by another driver version";
+        return {};
+    }
+    if (std::memcmp(header.pipelineCacheUUID, m_properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+        m_status = "pipeline cache UUID changed";
+        return {};
+    }
+
+    // the header isn't trusted with the allocation, its size has to match what the file actually holds
+    std::error_code error;
+    uintmax_t fileSize = std::filesystem::file_size(m_path, error);
+    if (error || fileSize < sizeof(header) || header.dataSize != fileSize - sizeof(header)) {
+        m_status = "truncated or corrupted";
+        return {};
+    }
+
+    std::vector<uint8_t> data(header.dataSize);
+    if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size())) || hashData(data) != header.dataHash) {
+        m_status = "truncated or corrupted";
+        return {};
+    }
+
+    m_warm = true;
+    m_status = "loaded " + std::to_string(data.size() / 1024) + " KiB from " + m_path;
+    return data;
+}
+
+void ASHUtil::PipelineCache::save() {
+    if (m_path.empty()) {
+        return;
+    }
+
+    std::vector<uint8_t> data = m_device.getPipelineCacheData(m_cache);
+
+    CacheFileHeader header{};
+    header.magic = cacheMagic;
+    header.formatVersion = cacheFormatVersion;
+    header.vendorID = m_properties.vendorID;
+    header.deviceID = m_properties.deviceID;
+    header.driverVersion = m_properties.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, m_properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+    header.dataSize = data.size();
+    header.dataHash = hashData(data);
+
+    std::string temporaryPath = m_path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        file.flush();
+        if (!file) {
+            std::cerr << yellow("Failed to write pipeline cache to " + temporaryPath) << std::endl;
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+    }
+
+    // rename replaces the target in one step on POSIX file systems
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, m_path, error);
+    if (error) {
+        std::cerr << yellow("Failed to replace " + m_path + ": " + error.message()) << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "libs.hpp"
+
+namespace ASHUtil {
+    // a vk::PipelineCache kept in a file between runs, only loaded when it was written by the same device and
+    // driver, since a driver update may reject or, worse, misread an older blob
+    class PipelineCache {
+        public:
+            // an empty path keeps the cache in memory only
+            PipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice, const std::string& path);
+            // writes the cache back
+            ~PipelineCache();
+
+            PipelineCache(const PipelineCache&) = delete;
+            PipelineCache& operator=(const PipelineCache&) = delete;
+
+            vk::PipelineCache get() const;
+
+            // whether the file held a cache for this device and driver
+            bool isWarm() const;
+
+            // why the cache started the way it did
+            const std::string& getStatus() const;
+
+            // to a temporary file renamed over the old one, so a crash mid-write leaves the old file intact
+            void save();
+
+        private:
+            vk::Device m_device;
+            vk::PhysicalDeviceProperties m_properties;
+            std::string m_path;
+            vk::PipelineCache m_cache;
+
+            bool m_warm = false;
+            std::string m_status;
+
+            std::vector<uint8_t> load();
+    };
+}
@@ -0,0 +1,113 @@
+#include "pipelineregistry.hpp"
+
+#include <chrono>
+
+uint64_t ASHUtil::hashState(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+ASHUtil::PipelineRegistry::PipelineRegistry(vk::Device device, JobSystem& jobs) : m_device(device), m_jobs(jobs) {}
+
+ASHUtil::PipelineRegistry::~PipelineRegistry() {
+    try {
+        waitAll();
+    } catch (...) {
+        // the failed variant was never bound, the rest still has to go
+    }
+
+    for (const auto& [key, variant] : m_variants) {
+        if (variant.pipeline) {
+            m_device.destroyPipeline(variant.pipeline);
+        }
+    }
+}
+
+void ASHUtil::PipelineRegistry::request(uint64_t key, const std::string& name, std::function<vk::Pipeline()> compile, uint64_t placeholderKey) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_variants.count(key)) {
+            return;
+        }
+
+        Variant& variant = m_variants[key];
+        variant.stats.name = name;
+        variant.stats.key = key;
+        variant.placeholderKey = placeholderKey;
+        m_order.push_back(key);
+    }
+
+    m_jobs.run([this, key, compile = std::move(compile)] {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        vk::Pipeline pipeline = compile();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Variant& variant = m_variants[key];
+        variant.pipeline = pipeline;
+        variant.stats.ready = true;
+        variant.stats.compileMs = ms;
+    }, m_compiling);
+}
+
+vk::Pipeline ASHUtil::PipelineRegistry::get(uint64_t key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto found = m_variants.find(key);
+    if (found != m_variants.end() && !found->second.stats.ready) {
+        ++found->second.stats.placeholderUses;
+    }
+    return resolveLocked(key);
+}
+
+vk::Pipeline ASHUtil::PipelineRegistry::resolve(uint64_t key) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return resolveLocked(key);
+}
+
+vk::Pipeline ASHUtil::PipelineRegistry::resolveLocked(uint64_t key) const {
+    auto found = m_variants.find(key);
+    if (found == m_variants.end()) {
+        return nullptr;
+    }
+    if (found->second.stats.ready) {
+        return found->second.pipeline;
+    }
+
+    // a placeholder still compiling stands in with its own, bounded in case the chain loops
+    uint64_t placeholderKey = found->second.placeholderKey;
+    for (size_t i = 0; i < m_variants.size(); ++i) {
+        auto placeholder = m_variants.find(placeholderKey);
+        if (placeholder == m_variants.end()) {
+            return nullptr;
+        }
+        if (placeholder->second.stats.ready) {
+            return placeholder->second.pipeline;
+        }
+        placeholderKey = placeholder->second.placeholderKey;
+    }
+    return nullptr;
+}
+
+bool ASHUtil::PipelineRegistry::isReady(uint64_t key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_variants.find(key);
+    return found != m_variants.end() && found->second.stats.ready;
+}
+
+void ASHUtil::PipelineRegistry::waitAll() {
+    m_jobs.wait(m_compiling);
+}
+
+std::vector<ASHUtil::PipelineVariantStats> ASHUtil::PipelineRegistry::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<PipelineVariantStats> stats;
+    for (uint64_t key : m_order) {
+        stats.push_back(m_variants.at(key).stats);
+    }
+    return stats;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "libs.hpp"
+#include "jobs.hpp"
+
+#include <mutex>
+#include <functional>
+
+namespace ASHUtil {
+    // FNV-1a, for building pipeline keys out of the state that describes them, also the engine's only byte hash
+    constexpr uint64_t stateHashSeed = 14695981039346656037ull;
+    uint64_t hashState(uint64_t hash, const void* data, size_t size);
+
+    // since the variant was requested
+    struct PipelineVariantStats {
+        std::string name;
+        uint64_t key = 0;
+        bool ready = false;
+        double compileMs = 0.0; // on whichever thread compiled it
+        uint64_t placeholderUses = 0; // binds of the placeholder while it compiled
+    };
+
+    // every pipeline the engine binds, keyed by a hash of its full state description, so requesting the same state
+    // twice shares one pipeline, compiles run as jobs so any number of variants build side by side
+    class PipelineRegistry {
+        public:
+            PipelineRegistry(vk::Device device, JobSystem& jobs);
+            // waits for compiles still running, then destroys every pipeline
+            ~PipelineRegistry();
+
+            PipelineRegistry(const PipelineRegistry&) = delete;
+            PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+            // queues compile unless key is already known, until it finishes get() answers with placeholderKey's pipeline
+            void request(uint64_t key, const std::string& name, std::function<vk::Pipeline()> compile, uint64_t placeholderKey = 0);
+
+            // the pipeline, the first ready one along its placeholders while it compiles, or null when none is
+            // for binding, a placeholder answer counts as one of the variant's placeholderUses
+            vk::Pipeline get(uint64_t key);
+            // the same answer as get() without touching the stats, for hashing or comparing handles
+            vk::Pipeline resolve(uint64_t key) const;
+
+            bool isReady(uint64_t key);
+
+            // helps compiling until every requested pipeline is done, rethrows if a compile failed
+            void waitAll();
+
+            // in request order
+            std::vector<PipelineVariantStats> getStats() const;
+
+        private:
+            struct Variant {
+                PipelineVariantStats stats;
+                vk::Pipeline pipeline;
+                uint64_t placeholderKey = 0;
+            };
+
+            vk::Device m_device;
+            JobSystem& m_jobs;
+
+            mutable std::mutex m_mutex;
+            std::unordered_map<uint64_t, Variant> m_variants;
+            std::vector<uint64_t> m_order;
+
+            // get() and resolve() with m_mutex held
+            vk::Pipeline resolveLocked(uint64_t key) const;
+
+            JobCounter m_compiling;
+    };
+}
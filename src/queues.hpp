@@ -6,6 +6,7 @@ namespace ASHUtil {
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        std::optional<uint32_t> transferFamily; // only set when it differs from the graphics family
 
         bool isComplete() {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -38,7 +39,9 @@ namespace ASHUtil {
                 #endif
             }
 
-            if (device.getSurfaceSupportKHR(i, surface)) {
+            // headless, nothing is presented, so the graphics family stands in
+            bool presents = surface ? device.getSurfaceSupportKHR(i, surface) : bool(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics);
+            if (presents) {
                 indices.presentFamily = i;
 
                 #ifdef DEBUG
@@ -55,6 +58,27 @@ namespace ASHUtil {
 
         }
 
+        // a family that can copy but not draw or dispatch is usually a separate DMA engine, any other family
+        // that isn't the graphics one still lets uploads run beside rendering
+        for (uint32_t j = 0; j < queueFamilies.size() && !indices.transferFamily.has_value(); ++j) {
+            vk::QueueFlags flags = queueFamilies[j].queueFlags;
+            if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+                indices.transferFamily = j;
+            }
+        }
+        for (uint32_t j = 0; j < queueFamilies.size() && !indices.transferFamily.has_value(); ++j) {
+            vk::QueueFlags flags = queueFamilies[j].queueFlags;
+            if ((flags & (vk::QueueFlagBits::eTransfer | vk::QueueFlagBits::eCompute)) && j != indices.graphicsFamily) {
+                indices.transferFamily = j;
+            }
+        }
+
+        #ifdef DEBUG
+        if (log && indices.transferFamily.has_value()) {
+            std::cout << "Queue family " << indices.transferFamily.value() << " used for transfers" << std::endl;
+        }
+        #endif
+
         return indices;
     }
 
@@ -6,4 +6,9 @@ namespace ASHUtil {
     struct ObjectData {
         glm::mat4 model;
     };
+
+    // pushed before each draw when EngineConfig::drawPushConstants is set, matches DrawParams in shader.vert
+    struct DrawParams {
+        uint32_t material;
+    };
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "scene.hpp"
 
+#include <cmath>
+
 Scene::Scene() {
 	positions.insert({ meshTypes::VOXEL, {} });
 	positions.insert({ meshTypes::GROUND, {} });
@@ -11,4 +13,19 @@ Scene::Scene() {
 	// positions[meshTypes::SKULL].push_back(glm::vec3(15.0f, -5.0f, 1.0f));
 	// positions[meshTypes::SKULL].push_back(glm::vec3(15.0f, 5.0f, 1.0f));
 
-};
\ No newline at end of file
+};
+void Scene::update(double deltaTime) {
+	time += deltaTime;
+
+	if (spin == 0.0f) {
+		return;
+	}
+
+	float angle = spin * static_cast<float>(deltaTime);
+	float c = std::cos(angle), s = std::sin(angle);
+	for (auto& [type, typePositions] : positions) {
+		for (glm::vec3& position : typePositions) {
+			position = glm::vec3(c * position.x - s * position.y, s * position.x + c * position.y, position.z);
+		}
+	}
+}
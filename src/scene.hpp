@@ -6,6 +6,12 @@ class Scene {
     public:
         Scene();
 
+        // advances the simulation by deltaTime seconds
+        void update(double deltaTime);
+
         std::unordered_map<meshTypes, std::vector<glm::vec3>> positions; // TODO: change to mat4 for position, rotation, scale
 
+        double time = 0.0; // simulated seconds
+        float spin = 0.0f; // radians per second everything orbits the z axis with, 0 keeps the scene static
+
 };
\ No newline at end of file
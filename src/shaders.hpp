@@ -1,6 +1,9 @@
 #pragma once
 
 #include "libs.hpp"
+#include "embeddedshaders.hpp"
+
+#include <filesystem>
 
 namespace ASHUtil {
     std::vector<char> readFile(const std::string &filename) {
@@ -23,18 +26,41 @@ namespace ASHUtil {
         return buffer;
     }
 
-    vk::ShaderModule createShaderModule(std::string filename, vk::Device device) {
-        std::vector<char> code = readFile(filename);
+    // compiled into the binary by shaders/embed.sh, name is the file name of the compiled shader
+    std::span<const uint32_t> findEmbeddedShader(const std::string& name) {
+        for (const EmbeddedShader& shader : embeddedShaders) {
+            if (shader.name == name) {
+                return shader.code;
+            }
+        }
+        throw std::runtime_error("Shader not embedded: " + name);
+    }
 
+    vk::ShaderModule createShaderModule(std::span<const uint32_t> code, vk::Device device, const std::string& name) {
         vk::ShaderModuleCreateInfo createInfo = {};
         createInfo.flags = vk::ShaderModuleCreateFlags();
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        createInfo.codeSize = code.size_bytes();
+        createInfo.pCode = code.data();
 
         try {
             return device.createShaderModule(createInfo);
         } catch (const vk::SystemError &err) {
-            throw std::runtime_error("Failed to create shader module: " + filename);
+            throw std::runtime_error("Failed to create shader module: " + name);
         }
     }
+
+    // the embedded shader, unless overrideDirectory is set and has a file of that name, which is read instead so
+    // shaders can be rebuilt without relinking
+    vk::ShaderModule createShaderModule(const std::string& name, vk::Device device, const std::string& overrideDirectory) {
+        if (!overrideDirectory.empty()) {
+            std::filesystem::path path = std::filesystem::path(overrideDirectory) / name;
+            std::error_code error;
+            if (std::filesystem::is_regular_file(path, error)) {
+                std::vector<char> code = readFile(path.string());
+                return createShaderModule(std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(code.data()), code.size() / sizeof(uint32_t)), device, path.string());
+            }
+        }
+
+        return createShaderModule(findEmbeddedShader(name), device, name);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "libs.hpp"
+
+namespace ASHUtil {
+    // filled in by the engine every frame, read by the app for reporting
+    struct FrameStats {
+        uint32_t totalInstances = 0;
+        uint32_t visibleInstances = 0;
+        uint32_t occludedInstances = 0; // passed the frustum test but failed the depth pyramid test
+        uint64_t fragmentInvocations = 0; // shaded by the last finished frame, 0 without pipeline statistics
+        uint64_t recordedFrames = 0;    // frames whose commands were recorded rather than replayed from the cache
+        uint32_t swapchainRecreations = 0;
+        double swapchainRecreateMs = 0.0; // how long the last recreation held up the render thread
+
+        // both from the start of the frame on the CPU and smoothed over roughly the last 20 frames
+        double presentLatencyMs = 0.0; // until the present call returned
+        double gpuLatencyMs = 0.0;     // until the GPU finished the frame's commands
+    };
+
+    // per thread cost of one step, smoothed over roughly the last 20 steps, filled in by the app
+    // with a separate simulation thread the two overlap, so their sum can exceed the frame time
+    struct ThreadTimings {
+        double simulationMs = 0.0; // one Scene::update, plus publishing the snapshot when threaded
+        double renderMs = 0.0;     // one Engine::render call
+        uint64_t simulationSteps = 0;
+        uint64_t renderedFrames = 0;
+    };
+
+    // summed over a run of frames, only collected when BENCHMARK is defined
+    struct FrameTimings {
+        uint32_t frames = 0;
+        double frameMs = 0.0; // between the starts of consecutive frames
+        double waitMs = 0.0;  // blocked until the timeline reached the ring slot's last value
+        double cpuMs = 0.0;   // preparing, recording, submitting and presenting
+        double gpuMs = 0.0;   // between the first and last timestamp of the command buffer
+
+        // the frames that recreated the swapchain, also included in frameMs
+        uint32_t resizes = 0;
+        double resizeFrameMs = 0.0;
+        double maxResizeFrameMs = 0.0;
+    };
+}
@@ -76,27 +76,22 @@ namespace ASHInit {
         return availableFormats[0];
     }
 
-    vk::PresentModeKHR choosePresentMode(std::vector<vk::PresentModeKHR> availableModes) {
-        #ifdef FORCE_IMMEDIATE_PRESENT
-        #ifdef DEBUG
-        std::cout << "Using immediate present mode" << std::endl;
-        #endif
-        return vk::PresentModeKHR::eImmediate;
-        #endif
-
+    // FIFO is the only mode every device has to support, so it is what an unavailable request falls back to
+    vk::PresentModeKHR choosePresentMode(std::vector<vk::PresentModeKHR> availableModes, vk::PresentModeKHR requestedMode) {
+        vk::PresentModeKHR chosen = vk::PresentModeKHR::eFifo;
         for (const auto &availableMode : availableModes) {
-            if (availableMode == vk::PresentModeKHR::eMailbox) {
-                #ifdef DEBUG
-                std::cout << "Using mailbox present mode" << std::endl;
-                #endif
-                return availableMode;
+            if (availableMode == requestedMode) {
+                chosen = availableMode;
             }
         }
 
         #ifdef DEBUG
-        std::cout << "Using FIFO present mode" << std::endl;
+        std::cout << "Using " << vk::to_string(chosen) << " present mode" << std::endl;
+        if (chosen != requestedMode) {
+            std::cout << yellow(vk::to_string(requestedMode) + " present mode unsupported") << std::endl;
+        }
         #endif
-        return vk::PresentModeKHR::eFifo;
+        return chosen;
     }
 
     vk::Extent2D chooseSwapExtent(uint32_t width, uint32_t height, vk::SurfaceCapabilitiesKHR capabilities) {
@@ -113,11 +108,11 @@ namespace ASHInit {
         }
     }
 
-    SwapChainBundle createSwapchain(vk::Device logialDevice, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, int width, int height) {
+    SwapChainBundle createSwapchain(vk::Device logialDevice, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, int width, int height, vk::PresentModeKHR requestedPresentMode, vk::SwapchainKHR oldSwapchain = nullptr) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, surface);
 
         vk::SurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(swapChainSupport.formats);
-        vk::PresentModeKHR presentMode = choosePresentMode(swapChainSupport.presentModes);
+        vk::PresentModeKHR presentMode = choosePresentMode(swapChainSupport.presentModes, requestedPresentMode);
         vk::Extent2D extent = chooseSwapExtent(width, height, swapChainSupport.capabilities);
 
         uint32_t imageCount = std::min(swapChainSupport.capabilities.maxImageCount, swapChainSupport.capabilities.minImageCount + 1);
@@ -149,7 +144,8 @@ namespace ASHInit {
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        vk::SwapchainKHR swapChain = vk::SwapchainKHR(nullptr);
+        // lets the driver hand resources over, the old swapchain is retired but stays valid for presents already queued
+        createInfo.oldSwapchain = oldSwapchain;
 
         SwapChainBundle bundle{};
         try {
@@ -0,0 +1,112 @@
+#include "timeline.hpp"
+
+ASHUtil::Timeline::Timeline(vk::Device device) : m_device(device) {
+    vk::SemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+    typeInfo.initialValue = 0;
+
+    vk::SemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.pNext = &typeInfo;
+
+    try {
+        m_semaphore = m_device.createSemaphore(semaphoreInfo);
+    } catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create timeline semaphore");
+    }
+}
+
+ASHUtil::Timeline::~Timeline() {
+    wait(m_lastSubmitted);
+    collect();
+
+    m_device.destroySemaphore(m_semaphore);
+}
+
+vk::Semaphore ASHUtil::Timeline::getSemaphore() const {
+    return m_semaphore;
+}
+
+uint64_t ASHUtil::Timeline::submit(vk::Queue queue, vk::CommandBuffer commandBuffer, const std::vector<SubmitWait>& waits, vk::Semaphore signalSemaphore) {
+    uint64_t value = m_lastSubmitted + 1;
+
+    // values of binary semaphores are ignored but the arrays have to line up with the semaphores
+    std::vector<vk::Semaphore> signalSemaphores = {m_semaphore};
+    std::vector<uint64_t> signalValues = {value};
+    if (signalSemaphore) {
+        signalSemaphores.push_back(signalSemaphore);
+        signalValues.push_back(0);
+    }
+
+    std::vector<vk::Semaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<vk::PipelineStageFlags> waitStages;
+    for (const SubmitWait& wait : waits) {
+        waitSemaphores.push_back(wait.semaphore);
+        waitValues.push_back(wait.value);
+        waitStages.push_back(wait.stage);
+    }
+
+    vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    vk::SubmitInfo submitInfo{};
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    try {
+        queue.submit(submitInfo, nullptr);
+    } catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to submit command buffer");
+    }
+
+    m_lastSubmitted = value;
+    return value;
+}
+
+uint64_t ASHUtil::Timeline::getLastSubmitted() const {
+    return m_lastSubmitted;
+}
+
+bool ASHUtil::Timeline::isComplete(uint64_t value) {
+    if (value > m_completed) {
+        m_completed = m_device.getSemaphoreCounterValue(m_semaphore);
+    }
+    return value <= m_completed;
+}
+
+void ASHUtil::Timeline::wait(uint64_t value) {
+    if (value <= m_completed) {
+        return;
+    }
+
+    vk::SemaphoreWaitInfo waitInfo{};
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_semaphore;
+    waitInfo.pValues = &value;
+
+    if (m_device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to wait on timeline semaphore");
+    }
+
+    m_completed = std::max(m_completed, value);
+}
+
+void ASHUtil::Timeline::destroyAfter(uint64_t value, std::function<void()> destroy) {
+    m_deletions.emplace_back(value, std::move(destroy));
+}
+
+void ASHUtil::Timeline::collect() {
+    while (!m_deletions.empty() && isComplete(m_deletions.front().first)) {
+        m_deletions.front().second();
+        m_deletions.pop_front();
+    }
+}
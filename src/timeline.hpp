@@ -0,0 +1,59 @@
+#pragma once
+
+#include "libs.hpp"
+
+#include <functional>
+#include <deque>
+
+namespace ASHUtil {
+    // a semaphore a submission waits on before stage, value is ignored for binary semaphores
+    struct SubmitWait {
+        vk::Semaphore semaphore;
+        uint64_t value = 0;
+        vk::PipelineStageFlags stage;
+    };
+
+    // one timeline semaphore that every submission signals with the next value, so "has this finished" is a
+    // single integer comparison and waiting on any mix of frames and uploads is waiting on the largest value
+    class Timeline {
+        public:
+            explicit Timeline(vk::Device device);
+            ~Timeline();
+
+            Timeline(const Timeline&) = delete;
+            Timeline& operator=(const Timeline&) = delete;
+
+            vk::Semaphore getSemaphore() const;
+
+            // submits commandBuffer after waits, optionally also signaling a binary semaphore for presentation,
+            // and returns the value the timeline reaches once it has finished
+            uint64_t submit(
+                vk::Queue queue, vk::CommandBuffer commandBuffer,
+                const std::vector<SubmitWait>& waits = {}, vk::Semaphore signalSemaphore = nullptr
+            );
+
+            // value of the most recent submission, waiting on it drains everything submitted so far
+            uint64_t getLastSubmitted() const;
+
+            bool isComplete(uint64_t value);
+
+            // returns immediately for values that are known to have completed
+            void wait(uint64_t value);
+
+            // destroy runs once the timeline reaches value, from collect() or the destructor
+            void destroyAfter(uint64_t value, std::function<void()> destroy);
+
+            // runs every deferred destruction whose value has been reached
+            void collect();
+
+        private:
+            vk::Device m_device;
+            vk::Semaphore m_semaphore;
+
+            uint64_t m_lastSubmitted = 0;
+            uint64_t m_completed = 0; // last value read back, only grows
+
+            // submission order, so the values are sorted
+            std::deque<std::pair<uint64_t, std::function<void()>>> m_deletions;
+    };
+}
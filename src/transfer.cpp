@@ -0,0 +1,158 @@
+#include "transfer.hpp"
+#include "onetimecommands.hpp"
+
+ASHUtil::TransferQueue::TransferQueue(TransferQueueInput input) {
+    m_device = input.device;
+    m_queue = input.queue;
+    m_transferFamily = input.transferFamily;
+    m_graphicsFamily = input.graphicsFamily;
+
+    vk::CommandPoolCreateInfo poolInfo{};
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    poolInfo.queueFamilyIndex = m_transferFamily;
+
+    try {
+        m_commandPool = m_device.createCommandPool(poolInfo);
+    } catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create transfer command pool");
+    }
+
+    vk::CommandBufferAllocateInfo allocInfo{};
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.level = vk::CommandBufferLevel::ePrimary;
+    allocInfo.commandBufferCount = 1;
+
+    try {
+        m_commandBuffer = m_device.allocateCommandBuffers(allocInfo)[0];
+    } catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to allocate transfer command buffer");
+    }
+
+    m_timeline = new Timeline(m_device);
+}
+
+ASHUtil::TransferQueue::~TransferQueue() {
+    // waits for the last job and frees its staging memory
+    delete m_timeline;
+
+    m_device.destroyCommandPool(m_commandPool);
+}
+
+vk::CommandBuffer ASHUtil::TransferQueue::begin() {
+    startJob(m_commandBuffer, *m_timeline);
+    return m_commandBuffer;
+}
+
+void ASHUtil::TransferQueue::releaseBuffer(vk::Buffer buffer, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess) {
+    vk::BufferMemoryBarrier barrier;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = m_transferFamily;
+    barrier.dstQueueFamilyIndex = m_graphicsFamily;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    m_bufferBarriers.push_back(barrier);
+    m_stages |= dstStage;
+}
+
+void ASHUtil::TransferQueue::releaseImage(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess) {
+    vk::ImageMemoryBarrier barrier;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = m_transferFamily;
+    barrier.dstQueueFamilyIndex = m_graphicsFamily;
+    barrier.image = image;
+    barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, 1);
+
+    m_imageBarriers.push_back(barrier);
+    m_stages |= dstStage;
+}
+
+uint64_t ASHUtil::TransferQueue::submit() {
+    if (!m_bufferBarriers.empty() || !m_imageBarriers.empty()) {
+        if (isDedicated()) {
+            // release half of the ownership transfer, the destination access happens in the acquire on the graphics queue
+            std::vector<vk::BufferMemoryBarrier> bufferBarriers = m_bufferBarriers;
+            std::vector<vk::ImageMemoryBarrier> imageBarriers = m_imageBarriers;
+            for (vk::BufferMemoryBarrier& barrier : bufferBarriers) {
+                barrier.dstAccessMask = vk::AccessFlags();
+            }
+            for (vk::ImageMemoryBarrier& barrier : imageBarriers) {
+                barrier.dstAccessMask = vk::AccessFlags();
+            }
+
+            m_commandBuffer.pipelineBarrier(
+                vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+                vk::DependencyFlags(), nullptr, bufferBarriers, imageBarriers
+            );
+
+            m_pendingBuffers.insert(m_pendingBuffers.end(), m_bufferBarriers.begin(), m_bufferBarriers.end());
+            m_pendingImages.insert(m_pendingImages.end(), m_imageBarriers.begin(), m_imageBarriers.end());
+            m_pendingStages |= m_stages;
+        } else {
+            // on the graphics queue itself a plain barrier does the whole job
+            for (vk::BufferMemoryBarrier& barrier : m_bufferBarriers) {
+                barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            }
+            for (vk::ImageMemoryBarrier& barrier : m_imageBarriers) {
+                barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            }
+
+            m_commandBuffer.pipelineBarrier(
+                vk::PipelineStageFlagBits::eTransfer, m_stages,
+                vk::DependencyFlags(), nullptr, m_bufferBarriers, m_imageBarriers
+            );
+        }
+
+        m_bufferBarriers.clear();
+        m_imageBarriers.clear();
+        m_stages = vk::PipelineStageFlags();
+    }
+
+    uint64_t value = endJob(m_commandBuffer, m_queue, *m_timeline);
+    if (isDedicated()) {
+        m_pendingValue = value;
+    }
+    return value;
+}
+
+ASHUtil::SubmitWait ASHUtil::TransferQueue::recordAcquires(vk::CommandBuffer commandBuffer) {
+    SubmitWait wait{};
+
+    // jobs on the shared queue are ordered by their own barriers, only released resources need anything here
+    if (m_pendingBuffers.empty() && m_pendingImages.empty()) {
+        return wait;
+    }
+
+    // the semaphore wait covers the release, so the acquire starts from the stages it waits at
+    commandBuffer.pipelineBarrier(
+        m_pendingStages, m_pendingStages,
+        vk::DependencyFlags(), nullptr, m_pendingBuffers, m_pendingImages
+    );
+
+    wait.semaphore = m_timeline->getSemaphore();
+    wait.value = m_pendingValue;
+    wait.stage = m_pendingStages;
+
+    m_pendingBuffers.clear();
+    m_pendingImages.clear();
+    m_pendingStages = vk::PipelineStageFlags();
+
+    return wait;
+}
+
+bool ASHUtil::TransferQueue::hasPendingAcquires() const {
+    return !m_pendingBuffers.empty() || !m_pendingImages.empty();
+}
+
+ASHUtil::Timeline& ASHUtil::TransferQueue::getTimeline() {
+    return *m_timeline;
+}
+
+bool ASHUtil::TransferQueue::isDedicated() const {
+    return m_transferFamily != m_graphicsFamily;
+}
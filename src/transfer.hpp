@@ -0,0 +1,61 @@
+#pragma once
+
+#include "libs.hpp"
+#include "timeline.hpp"
+
+namespace ASHUtil {
+    struct TransferQueueInput {
+        vk::Device device;
+        vk::Queue queue;
+        uint32_t transferFamily;
+        uint32_t graphicsFamily; // the same as transferFamily when there is no separate family
+    };
+
+    // uploads recorded on their own queue and timeline, so they never wait for rendering or make it wait,
+    // except for the frame that first uses what they wrote
+    class TransferQueue {
+        public:
+            TransferQueue(TransferQueueInput input);
+            ~TransferQueue();
+
+            TransferQueue(const TransferQueue&) = delete;
+            TransferQueue& operator=(const TransferQueue&) = delete;
+
+            // starts a job, the returned command buffer is recorded into until submit()
+            vk::CommandBuffer begin();
+
+            // hand what the current job wrote over to the graphics queue, stage and access are where it is used there
+            void releaseBuffer(vk::Buffer buffer, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess);
+            void releaseImage(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess);
+
+            // returns the value of getTimeline() the job finishes at, staging memory can be freed after it
+            uint64_t submit();
+
+            // records the matching acquire barriers of every submitted job into a graphics command buffer and returns
+            // what its submission has to wait on, the semaphore is null when nothing was pending
+            SubmitWait recordAcquires(vk::CommandBuffer commandBuffer);
+
+            // true when the next recordAcquires would record anything
+            bool hasPendingAcquires() const;
+
+            Timeline& getTimeline();
+
+            // false when transfers share the graphics queue
+            bool isDedicated() const;
+
+        private:
+            vk::Device m_device;
+            vk::Queue m_queue;
+            uint32_t m_transferFamily, m_graphicsFamily;
+
+            vk::CommandPool m_commandPool;
+            vk::CommandBuffer m_commandBuffer;
+            Timeline* m_timeline;
+
+            // released in the job being recorded, then waiting for a frame to acquire them
+            std::vector<vk::BufferMemoryBarrier> m_bufferBarriers, m_pendingBuffers;
+            std::vector<vk::ImageMemoryBarrier> m_imageBarriers, m_pendingImages;
+            vk::PipelineStageFlags m_stages, m_pendingStages;
+            uint64_t m_pendingValue = 0;
+    };
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "libs.hpp"
+
+#include <atomic>
+
+namespace ASHUtil {
+    // one writer and one reader on different threads, neither ever waits on the other: the writer fills its own
+    // copy and swaps it into the shared slot, the reader swaps the shared slot out whenever it holds something newer
+    template <typename T>
+    class TripleBuffer {
+        public:
+            explicit TripleBuffer(const T& initial) : m_buffers{initial, initial, initial} {}
+
+            TripleBuffer(const TripleBuffer&) = delete;
+            TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+            // writer only, still holds whatever it held two publishes ago
+            T& getWriteBuffer() {
+                return m_buffers[m_write];
+            }
+
+            // writer only, hands the write buffer to the reader and takes back the one it no longer needs
+            void publish() {
+                uint8_t previous = m_shared.exchange(m_write | freshBit, std::memory_order_acq_rel);
+                m_write = previous & indexMask;
+            }
+
+            // reader only, the newest published value, or the same one as last time if nothing new was published
+            const T& acquire() {
+                if (m_shared.load(std::memory_order_relaxed) & freshBit) {
+                    uint8_t previous = m_shared.exchange(m_read, std::memory_order_acq_rel);
+                    m_read = previous & indexMask;
+                }
+                return m_buffers[m_read];
+            }
+
+        private:
+            static constexpr uint8_t indexMask = 0x3;
+            static constexpr uint8_t freshBit = 0x4;
+
+            T m_buffers[3];
+            uint8_t m_write = 0;
+            uint8_t m_read = 1;
+            std::atomic<uint8_t> m_shared{2}; // index of the buffer between the two, with freshBit once published
+    };
+}
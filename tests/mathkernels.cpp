@@ -0,0 +1,153 @@
+// compares every supported SIMD level of the batch math kernels against GLM on random data
+#include "mathkernels.hpp"
+
+#include <random>
+
+using ASHMath::AABB;
+using ASHMath::Mat3x4;
+using ASHMath::Transform;
+using ASHMath::simdLevels;
+
+namespace {
+    // odd count so every kernel also runs its scalar tail
+    constexpr size_t testCount = 1027;
+
+    bool close(float a, float b) {
+        return std::abs(a - b) <= 1e-3f * std::max(1.0f, std::abs(b));
+    }
+
+    // bounds of the eight transformed corners, the brute force version of Arvo's method
+    AABB transformAABB(const glm::mat4& matrix, const AABB& box) {
+        AABB out = {glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec3 p = glm::vec3(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z);
+            glm::vec3 world = glm::vec3(matrix * glm::vec4(p, 1.0f));
+            out.min = glm::min(out.min, world);
+            out.max = glm::max(out.max, world);
+        }
+        return out;
+    }
+
+    bool sphereVisible(const glm::vec4& sphere, const std::vector<glm::vec4>& planes) {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main() {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+    std::vector<Transform> transforms(testCount);
+    std::vector<glm::mat4> lhs(testCount), rhs(testCount);
+    std::vector<AABB> inputBoxes(testCount);
+    std::vector<glm::vec4> spheres(testCount);
+    std::vector<glm::vec4> planes;
+
+    for (size_t i = 0; i < testCount; ++i) {
+        transforms[i].position = glm::vec3(dist(rng), dist(rng), dist(rng));
+        transforms[i].rotation = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        transforms[i].scale = glm::vec3(dist(rng), dist(rng), dist(rng));
+
+        for (int c = 0; c < 4; ++c) {
+            lhs[i][c] = glm::vec4(dist(rng), dist(rng), dist(rng), dist(rng));
+            rhs[i][c] = glm::vec4(dist(rng), dist(rng), dist(rng), dist(rng));
+        }
+
+        glm::vec3 p = glm::vec3(dist(rng), dist(rng), dist(rng));
+        glm::vec3 q = glm::vec3(dist(rng), dist(rng), dist(rng));
+        inputBoxes[i] = {glm::min(p, q), glm::max(p, q)};
+
+        spheres[i] = glm::vec4(dist(rng), dist(rng), dist(rng), std::abs(dist(rng)) * 0.2f);
+    }
+    for (int p = 0; p < 6; ++p) {
+        glm::vec3 normal = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng)));
+        planes.push_back(glm::vec4(normal, 8.0f));
+    }
+
+    std::vector<glm::mat4> expectedTRS(testCount), expectedProducts(testCount);
+    std::vector<AABB> expectedBoxes(testCount);
+    std::vector<uint8_t> expectedVisible(testCount);
+    size_t expectedVisibleCount = 0;
+
+    for (size_t i = 0; i < testCount; ++i) {
+        const Transform& t = transforms[i];
+        expectedTRS[i] = glm::translate(glm::mat4(1.0f), t.position) * glm::mat4_cast(t.rotation) * glm::scale(glm::mat4(1.0f), t.scale);
+        expectedProducts[i] = lhs[i] * rhs[i];
+        expectedBoxes[i] = transformAABB(lhs[i], inputBoxes[i]);
+        expectedVisible[i] = sphereVisible(spheres[i], planes);
+        expectedVisibleCount += expectedVisible[i];
+    }
+
+    int failed = 0;
+    simdLevels supported = ASHMath::detectSimdLevel();
+
+    for (int l = 0; l <= static_cast<int>(supported); ++l) {
+        ASHMath::setSimdLevel(static_cast<simdLevels>(l));
+        int errors = 0;
+
+        std::vector<glm::mat4> matrices(testCount);
+        std::vector<Mat3x4> affine(testCount);
+        ASHMath::composeTransforms(transforms.data(), matrices.data(), testCount);
+        ASHMath::composeTransforms3x4(transforms.data(), affine.data(), testCount);
+        for (size_t i = 0; i < testCount; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                for (int r = 0; r < 4; ++r) {
+                    errors += !close(matrices[i][c][r], expectedTRS[i][c][r]);
+                    if (r < 3) {
+                        errors += !close(affine[i].m[r][c], expectedTRS[i][c][r]);
+                    }
+                }
+            }
+        }
+
+        ASHMath::multiplyMatrices(lhs.data(), rhs.data(), matrices.data(), testCount);
+        for (size_t i = 0; i < testCount; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                for (int r = 0; r < 4; ++r) {
+                    errors += !close(matrices[i][c][r], expectedProducts[i][c][r]);
+                }
+            }
+        }
+
+        ASHMath::premultiplyMatrices(lhs[0], rhs.data(), matrices.data(), testCount);
+        for (size_t i = 0; i < testCount; ++i) {
+            glm::mat4 expected = lhs[0] * rhs[i];
+            for (int c = 0; c < 4; ++c) {
+                for (int r = 0; r < 4; ++r) {
+                    errors += !close(matrices[i][c][r], expected[c][r]);
+                }
+            }
+        }
+
+        std::vector<AABB> boxes(testCount);
+        ASHMath::transformAABBs(lhs.data(), inputBoxes.data(), boxes.data(), testCount);
+        for (size_t i = 0; i < testCount; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                errors += !close(boxes[i].min[k], expectedBoxes[i].min[k]);
+                errors += !close(boxes[i].max[k], expectedBoxes[i].max[k]);
+            }
+        }
+
+        std::vector<uint8_t> visible(testCount);
+        size_t visibleCount = ASHMath::testSpheres(spheres.data(), testCount, planes.data(), planes.size(), visible.data());
+        errors += visibleCount != expectedVisibleCount;
+        for (size_t i = 0; i < testCount; ++i) {
+            errors += visible[i] != expectedVisible[i];
+        }
+
+        std::string name = ASHMath::simdLevelName(static_cast<simdLevels>(l));
+        if (errors == 0) {
+            std::cout << green("Math kernels (" + name + ") match GLM") << std::endl;
+        } else {
+            std::cerr << red("Math kernels (" + name + ") mismatch: ") << errors << " values" << std::endl;
+            ++failed;
+        }
+    }
+
+    return failed == 0 ? 0 : 1;
+}